@@ -0,0 +1,321 @@
+// benchmarks for the v_alloc paths against libc, posix only
+// cc -O2 -pthread -I. bench/v_alloc_bench.c v_alloc.c -o v_alloc_bench && ./v_alloc_bench
+#define _GNU_SOURCE
+#include "v_alloc.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+#endif
+
+#define KB ((size_t)1024)
+#define MB (1024 * KB)
+#define GB (1024 * MB)
+
+typedef struct Measure {
+    struct timespec start;
+    long minflt;
+    long majflt;
+    long long syscalls;
+} Measure;
+
+// syscall count through the raw_syscalls:sys_enter tracepoint, needs tracefs and perf permissions.
+// -1 when unavailable, the column then prints '-'
+static int bench_syscall_fd = -1;
+
+static void bench_syscalls_open(void) {
+#if defined(__linux__)
+    const char *paths[] = {
+        "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+    };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        FILE *file = fopen(paths[i], "r");
+        if (!file) {
+            continue;
+        }
+        unsigned long long id = 0;
+        int found = fscanf(file, "%llu", &id) == 1;
+        fclose(file);
+        if (!found) {
+            continue;
+        }
+        struct perf_event_attr attr = {0};
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.size = sizeof(attr);
+        attr.config = id;
+        attr.inherit = 1; // count threads spawned by the multi threaded workloads
+        attr.exclude_kernel = 0;
+        bench_syscall_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        return;
+    }
+#endif
+}
+static long long bench_syscalls_read(void) {
+    long long count = -1;
+    if (bench_syscall_fd < 0 || read(bench_syscall_fd, &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+    }
+    return count;
+}
+static double bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+static void bench_begin(Measure *measure) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    measure->minflt = usage.ru_minflt;
+    measure->majflt = usage.ru_majflt;
+    measure->syscalls = bench_syscalls_read();
+    clock_gettime(CLOCK_MONOTONIC, &measure->start);
+}
+// elapsed_ns < 0 measures from bench_begin
+static void bench_end_ns(Measure *measure, const char *name, size_t ops, double elapsed_ns) {
+    if (elapsed_ns < 0) {
+        elapsed_ns = bench_now_ns() - (measure->start.tv_sec * 1e9 + measure->start.tv_nsec);
+    }
+    long long syscalls = bench_syscalls_read();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    char syscall_text[32] = "-";
+    if (syscalls >= 0 && measure->syscalls >= 0) {
+        snprintf(syscall_text, sizeof(syscall_text), "%lld", syscalls - measure->syscalls);
+    }
+    printf("%-44s %12zu %10.2f %12s %10ld %8ld\n", name, ops, elapsed_ns / (double)ops,
+           syscall_text, usage.ru_minflt - measure->minflt, usage.ru_majflt - measure->majflt);
+}
+static void bench_end(Measure *measure, const char *name, size_t ops) {
+    bench_end_ns(measure, name, ops, -1);
+}
+// keeps the compiler from dropping stores into memory we never read back
+static void bench_escape(void *ptr) {
+    __asm__ __volatile__("" : : "g"(ptr) : "memory");
+}
+// xorshift, deterministic across runs
+static uint32_t bench_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// MARK: bump
+static void bench_bump(size_t size, size_t commit_chunk, size_t commit_max, const char *policy) {
+    char name[64];
+    snprintf(name, sizeof(name), "committ %5zu B, %s", size, policy);
+    AllocInfo alloc_info = {0};
+    v_alloc_reserve(&alloc_info, 4 * GB);
+    v_alloc_set_commit_policy(&alloc_info, commit_chunk, commit_max);
+    size_t ops = (512 * MB) / size;
+    Measure measure;
+    bench_begin(&measure);
+    for (size_t i = 0; i < ops; i++) {
+        char *ptr = v_alloc_committ(&alloc_info, size);
+        ptr[0] = 1;
+    }
+    bench_end(&measure, name, ops);
+    v_alloc_free(&alloc_info);
+}
+static void bench_malloc_bump(size_t size) {
+    char name[64];
+    snprintf(name, sizeof(name), "malloc  %5zu B, never freed", size);
+    size_t ops = (512 * MB) / size;
+    void **ptrs = malloc(ops * sizeof(void *));
+    Measure measure;
+    bench_begin(&measure);
+    for (size_t i = 0; i < ops; i++) {
+        char *ptr = malloc(size);
+        ptr[0] = 1;
+        ptrs[i] = ptr;
+    }
+    bench_end(&measure, name, ops);
+    for (size_t i = 0; i < ops; i++) {
+        free(ptrs[i]);
+    }
+    free(ptrs);
+}
+
+// MARK: realloc growth
+static void bench_growth(bool use_v_alloc, bool doubling) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s 4 KiB -> 1 GiB, %s", use_v_alloc ? "v_alloc_realloc" : "realloc        ",
+             doubling ? "x2" : "+64 KiB");
+    size_t ops = 0;
+    char *data = NULL;
+    size_t old_size = 0;
+    Measure measure;
+    bench_begin(&measure);
+    for (size_t size = 4 * KB; size <= 1 * GB - 64 * KB; size = doubling ? size * 2 : size + 64 * KB) {
+        data = use_v_alloc ? v_alloc_realloc(data, size) : realloc(data, size);
+        memset(data + old_size, 1, size - old_size); // touch what's new like a growing buffer would
+        old_size = size;
+        ops++;
+    }
+    bench_end(&measure, name, ops);
+    if (use_v_alloc) {
+        v_alloc_realloc(data, 0);
+    } else {
+        free(data);
+    }
+}
+
+// MARK: reset
+static void bench_reset(size_t retain_size, const char *policy) {
+    char name[64];
+    snprintf(name, sizeof(name), "reset cycles 4 MiB of 64 B, %s", policy);
+    AllocInfo alloc_info = {0};
+    v_alloc_reserve(&alloc_info, 1 * GB);
+    v_alloc_set_commit_policy(&alloc_info, 64 * KB, 0);
+    v_alloc_set_retain(&alloc_info, retain_size);
+    size_t cycles = 200, per_cycle = (4 * MB) / 64;
+    Measure measure;
+    bench_begin(&measure);
+    for (size_t cycle = 0; cycle < cycles; cycle++) {
+        // every 16th cycle is a burst, the retain policy should give it back without refaulting the rest
+        size_t count = cycle % 16 == 0 ? per_cycle * 8 : per_cycle;
+        for (size_t i = 0; i < count; i++) {
+            char *ptr = v_alloc_committ(&alloc_info, 64);
+            ptr[0] = 1;
+        }
+        v_alloc_reset(&alloc_info);
+    }
+    bench_end(&measure, name, cycles * per_cycle);
+    v_alloc_free(&alloc_info);
+}
+
+// MARK: churn
+// mimalloc-bench style: a working set of live objects with random sizes, each op replaces one of them
+#define CHURN_SLOTS 8192
+#define CHURN_OPS (4 * 1000 * 1000)
+static void bench_churn(int kind) {
+    const char *names[] = { "churn 16..1024 B, malloc/free", "churn 16..1024 B, v_malloc/v_free",
+                            "churn 64 B, v_pool" };
+    void **slots = calloc(CHURN_SLOTS, sizeof(void *));
+    VPool pool;
+    v_pool_init(&pool, 64, 0);
+    uint32_t state = 2463534242u;
+    Measure measure;
+    bench_begin(&measure);
+    for (size_t i = 0; i < CHURN_OPS; i++) {
+        uint32_t r = bench_rand(&state);
+        size_t slot = r % CHURN_SLOTS;
+        size_t size = 16 + (r >> 16) % 1009;
+        switch (kind) {
+        case 0: free(slots[slot]); slots[slot] = malloc(size); break;
+        case 1: v_free(slots[slot]); slots[slot] = v_malloc(size); break;
+        default: v_pool_free(&pool, slots[slot]); slots[slot] = v_pool_alloc(&pool); break;
+        }
+        memset(slots[slot], 1, 16);
+    }
+    bench_end(&measure, names[kind], CHURN_OPS);
+    for (size_t i = 0; i < CHURN_SLOTS && kind < 2; i++) {
+        if (kind == 0) {
+            free(slots[i]);
+        } else {
+            v_free(slots[i]);
+        }
+    }
+    v_pool_release(&pool);
+    free(slots);
+}
+
+// MARK: threads
+#define THREAD_OPS (1000 * 1000)
+typedef struct ThreadArgs {
+    AllocInfo *shared;
+    pthread_barrier_t *start;
+    int kind;
+    double elapsed_ns;
+} ThreadArgs;
+
+static void *bench_thread(void *arg) {
+    ThreadArgs *args = arg;
+    AllocInfo local = {0};
+    v_alloc_set_commit_policy(&local, 64 * KB, 0);
+    void **ptrs = args->kind == 2 ? malloc(THREAD_OPS * sizeof(void *)) : NULL;
+    pthread_barrier_wait(args->start);
+    double start_ns = bench_now_ns();
+    for (size_t i = 0; i < THREAD_OPS; i++) {
+        char *ptr;
+        switch (args->kind) {
+        case 0: ptr = v_alloc_committ_shared(args->shared, 64); break;
+        case 1: ptr = v_alloc_committ(&local, 64); break;
+        default: ptr = ptrs[i] = malloc(64); break;
+        }
+        ptr[0] = 1;
+        bench_escape(ptr);
+    }
+    args->elapsed_ns = bench_now_ns() - start_ns;
+    for (size_t i = 0; ptrs && i < THREAD_OPS; i++) {
+        free(ptrs[i]);
+    }
+    free(ptrs);
+    v_alloc_free(&local);
+    return NULL;
+}
+static void bench_threads(int kind, int thread_count) {
+    const char *kinds[] = { "committ_shared, one arena", "committ, arena per thread", "malloc" };
+    char name[64];
+    snprintf(name, sizeof(name), "%2d threads x 64 B, %s", thread_count, kinds[kind]);
+    AllocInfo shared = {0};
+    v_alloc_reserve(&shared, 8 * GB);
+    v_alloc_set_commit_policy(&shared, 64 * KB, 4 * MB);
+    pthread_t threads[64];
+    ThreadArgs args[64];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, thread_count);
+    Measure measure;
+    bench_begin(&measure);
+    for (int i = 0; i < thread_count; i++) {
+        args[i] = (ThreadArgs){ &shared, &start, kind, 0 };
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+    double elapsed_ns = 0;
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        elapsed_ns = args[i].elapsed_ns > elapsed_ns ? args[i].elapsed_ns : elapsed_ns;
+    }
+    // wall time of the slowest thread per op across all threads, linear scaling halves it with every doubling
+    bench_end_ns(&measure, name, (size_t)thread_count * THREAD_OPS, elapsed_ns);
+    pthread_barrier_destroy(&start);
+    v_alloc_free(&shared);
+}
+
+int main(void) {
+    bench_syscalls_open();
+    printf("%-44s %12s %10s %12s %10s %8s\n", "workload", "ops", "ns/op", "syscalls", "minflt", "majflt");
+    size_t sizes[] = { 16, 64, 256, 4096 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_bump(sizes[i], 0, 0, "page commits");
+        bench_bump(sizes[i], 64 * KB, 0, "64 KiB commits");
+        bench_bump(sizes[i], 64 * KB, 64 * MB, "geometric commits");
+        bench_malloc_bump(sizes[i]);
+    }
+    bench_growth(true, true);
+    bench_growth(false, true);
+    bench_growth(true, false);
+    bench_growth(false, false);
+    bench_reset(0, "keep all");
+    bench_reset(4 * MB, "retain 4 MiB");
+    bench_reset(64 * KB, "retain 64 KiB");
+    for (int kind = 0; kind < 3; kind++) {
+        bench_churn(kind);
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int kind = 0; kind < 3; kind++) {
+        for (int thread_count = 1; thread_count <= 64 && thread_count <= cpus; thread_count *= 2) {
+            bench_threads(kind, thread_count);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,494 @@
+// regression checks for the performance properties of v_alloc: commit syscalls per push, no refaults
+// after a reset with retention, stable realloc base and the shared bump path across threads
+// cc -O2 -pthread -I. tests/v_alloc_test.c v_alloc.c -o v_alloc_test && ./v_alloc_test
+// cl /O2 /I. tests\v_alloc_test.c v_alloc.c && v_alloc_test.exe
+#if !defined(_WIN32)
+    #define _GNU_SOURCE
+#endif
+#include "v_alloc.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <psapi.h>
+    #if defined(_MSC_VER)
+        #pragma comment(lib, "psapi.lib")
+    #endif
+#else
+    #include <pthread.h>
+    #include <sys/resource.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#define KB ((size_t)1024)
+#define MB (1024 * KB)
+#define GB (1024 * MB)
+
+static int test_failures;
+
+#define CHECK(cond, ...)                                               \
+    do {                                                               \
+        if (!(cond)) {                                                 \
+            printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond);     \
+            printf(__VA_ARGS__);                                       \
+            printf("\n");                                              \
+            test_failures++;                                           \
+        }                                                              \
+    } while (0)
+
+// MARK: platform
+// threads, a start barrier, a clock and the page fault counter. pthread_barrier_t is missing on macOS,
+// so the barrier is a mutex and a condition variable on every platform
+typedef struct TestThreadStart {
+    void (*fn)(void *arg);
+    void *arg;
+} TestThreadStart;
+
+#if defined(_WIN32)
+    typedef HANDLE TestThread;
+    typedef struct TestBarrier {
+        SRWLOCK lock;
+        CONDITION_VARIABLE cond;
+        int waiting;
+    } TestBarrier;
+
+    static double test_now_ns(void) {
+        static LARGE_INTEGER frequency;
+        LARGE_INTEGER counter;
+        if (frequency.QuadPart == 0) {
+            QueryPerformanceFrequency(&frequency);
+        }
+        QueryPerformanceCounter(&counter);
+        return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+    }
+    // soft and hard faults together, a demand zero page counts as one
+    static long test_minflt(void) {
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return (long)counters.PageFaultCount;
+    }
+    static long test_cpu_count(void) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (long)info.dwNumberOfProcessors;
+    }
+    static void test_barrier_init(TestBarrier *barrier, int count) {
+        InitializeSRWLock(&barrier->lock);
+        InitializeConditionVariable(&barrier->cond);
+        barrier->waiting = count;
+    }
+    static void test_barrier_wait(TestBarrier *barrier) {
+        AcquireSRWLockExclusive(&barrier->lock);
+        if (--barrier->waiting == 0) {
+            WakeAllConditionVariable(&barrier->cond);
+        }
+        while (barrier->waiting > 0) {
+            SleepConditionVariableSRW(&barrier->cond, &barrier->lock, INFINITE, 0);
+        }
+        ReleaseSRWLockExclusive(&barrier->lock);
+    }
+    static void test_barrier_destroy(TestBarrier *barrier) {
+        (void)barrier;
+    }
+    static DWORD WINAPI test_thread_main(LPVOID arg) {
+        TestThreadStart *start = arg;
+        start->fn(start->arg);
+        free(start);
+        return 0;
+    }
+    static bool test_thread_start(TestThread *thread, void (*fn)(void *arg), void *arg) {
+        TestThreadStart *start = malloc(sizeof(*start));
+        if (!start) {
+            return false;
+        }
+        start->fn = fn;
+        start->arg = arg;
+        *thread = CreateThread(NULL, 0, test_thread_main, start, 0, NULL);
+        if (!*thread) {
+            free(start);
+        }
+        return *thread != NULL;
+    }
+    static void test_thread_join(TestThread thread) {
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }
+#else
+    typedef pthread_t TestThread;
+    typedef struct TestBarrier {
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        int waiting;
+    } TestBarrier;
+
+    static double test_now_ns(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1e9 + now.tv_nsec;
+    }
+    static long test_minflt(void) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_minflt;
+    }
+    static long test_cpu_count(void) {
+        return sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    static void test_barrier_init(TestBarrier *barrier, int count) {
+        pthread_mutex_init(&barrier->lock, NULL);
+        pthread_cond_init(&barrier->cond, NULL);
+        barrier->waiting = count;
+    }
+    static void test_barrier_wait(TestBarrier *barrier) {
+        pthread_mutex_lock(&barrier->lock);
+        if (--barrier->waiting == 0) {
+            pthread_cond_broadcast(&barrier->cond);
+        }
+        while (barrier->waiting > 0) {
+            pthread_cond_wait(&barrier->cond, &barrier->lock);
+        }
+        pthread_mutex_unlock(&barrier->lock);
+    }
+    static void test_barrier_destroy(TestBarrier *barrier) {
+        pthread_cond_destroy(&barrier->cond);
+        pthread_mutex_destroy(&barrier->lock);
+    }
+    static void *test_thread_main(void *arg) {
+        TestThreadStart *start = arg;
+        start->fn(start->arg);
+        free(start);
+        return NULL;
+    }
+    static bool test_thread_start(TestThread *thread, void (*fn)(void *arg), void *arg) {
+        TestThreadStart *start = malloc(sizeof(*start));
+        if (!start) {
+            return false;
+        }
+        start->fn = fn;
+        start->arg = arg;
+        if (pthread_create(thread, NULL, test_thread_main, start) != 0) {
+            free(start);
+            return false;
+        }
+        return true;
+    }
+    static void test_thread_join(TestThread thread) {
+        pthread_join(thread, NULL);
+    }
+#endif
+
+static void test_touch(char *ptr, size_t size) {
+    for (size_t i = 0; i < size; i += 4096) {
+        ptr[i] = 1;
+    }
+    ptr[size - 1] = 1;
+}
+
+// MARK: counting backend
+// forwards to the os backend and counts the calls. commits run under the arena's commit_lock,
+// the plain counters are only checked with no pushes in flight
+static size_t test_commit_calls;
+static size_t test_decommit_calls;
+
+static bool test_commit(void *addr, size_t total_size, size_t additional_bytes) {
+    test_commit_calls++;
+    return v_alloc.commit(addr, total_size, additional_bytes);
+}
+static bool test_decommit(void *addr, size_t extra_size) {
+    test_decommit_calls++;
+    return v_alloc.decommit(addr, extra_size);
+}
+static V_Allocator test_backend;
+
+// commits the policy takes to get size bytes committed from nothing
+static size_t test_expected_commits(size_t size, size_t commit_chunk, size_t commit_max) {
+    size_t committed = 0;
+    size_t commits = 0;
+    while (committed < size) {
+        size_t step = commit_chunk;
+        if (commit_max) {
+            step = committed > step ? committed : step;
+            step = step < commit_max ? step : commit_max;
+        }
+        committed += step;
+        commits++;
+    }
+    return commits;
+}
+
+// MARK: commits
+static void test_commit_count(size_t count, size_t size, size_t commit_chunk, size_t commit_max) {
+    AllocInfo arena = { .backend = &test_backend };
+    CHECK(v_alloc_reserve(&arena, 1 * GB), "reserve");
+    v_alloc_set_commit_policy(&arena, commit_chunk, commit_max);
+    test_commit_calls = 0;
+    for (size_t i = 0; i < count; i++) {
+        char *ptr = v_alloc_committ(&arena, size);
+        if (!ptr) {
+            CHECK(ptr, "push %zu of %zu B", i, size);
+            break;
+        }
+        ptr[0] = 1;
+    }
+    size_t used = arena.ptr - arena.base;
+    size_t expected = test_expected_commits(used, commit_chunk, commit_max);
+    CHECK(test_commit_calls <= expected, "%zu x %zu B, chunk %zu, max %zu: %zu commits, expected at most %zu",
+          count, size, commit_chunk, commit_max, test_commit_calls, expected);
+    v_alloc_free(&arena);
+}
+
+// MARK: reset
+// regrowing to the size used before a reset touches only pages that stayed committed
+static void test_reset_refaults(size_t retain_size, size_t used, int cycles, const char *name) {
+    AllocInfo arena = { .backend = &test_backend };
+    CHECK(v_alloc_reserve(&arena, 1 * GB), "reserve");
+    v_alloc_set_retain(&arena, retain_size);
+    test_touch(v_alloc_committ(&arena, used), used);
+    test_decommit_calls = 0;
+    for (int cycle = 0; cycle < cycles; cycle++) {
+        v_alloc_reset(&arena);
+        long minflt = test_minflt();
+        char *ptr = v_alloc_committ(&arena, used);
+        test_touch(ptr, used);
+        long faults = test_minflt() - minflt;
+        // a handful of faults outside the arena (stack, libc) are tolerated, a refault costs one per page
+        CHECK(faults < 16, "%s, cycle %d: %ld minor faults regrowing %zu B", name, cycle, faults, used);
+    }
+    CHECK(test_decommit_calls == 0, "%s: %zu decommits", name, test_decommit_calls);
+    v_alloc_free(&arena);
+}
+
+// MARK: realloc
+static void test_realloc_base(void) {
+    char *data = v_alloc_realloc(NULL, 4 * KB);
+    CHECK(data, "first realloc");
+    if (!data) {
+        return;
+    }
+    data[0] = 42;
+    for (size_t size = 8 * KB; size <= 512 * MB; size *= 2) {
+        char *grown = v_alloc_realloc(data, size);
+        CHECK(grown, "growth to %zu B failed", size);
+        if (!grown) {
+            break;
+        }
+        CHECK(grown == data, "growth to %zu B moved the base from %p to %p", size, (void *)data, (void *)grown);
+        grown[size - 1] = 1;
+        data = grown;
+    }
+    CHECK(data[0] == 42, "contents lost in growth");
+    char *shrunk = v_alloc_realloc(data, 4 * KB);
+    CHECK(shrunk == data, "shrink moved the base");
+    v_alloc_realloc(data, 0);
+}
+
+// MARK: malloc
+// alignments past the small size classes have to end up in a large block with the header right before
+// the data, or usable size, realloc and free read a header that isn't there
+static void test_malloc_aligned(void) {
+    size_t cases[][2] = { { 100 * KB, 64 * KB }, { 1000, 1 * MB }, { 16, 32 * KB }, { 1, 64 * KB } };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t size = cases[i][0];
+        size_t align = cases[i][1];
+        char *ptr = v_malloc_aligned(size, align);
+        CHECK(ptr && ((uintptr_t)ptr & (align - 1)) == 0, "%zu B at %zu: %p", size, align, (void *)ptr);
+        if (!ptr) {
+            continue;
+        }
+        memset(ptr, 7, size);
+        size_t usable = v_malloc_usable_size(ptr);
+        CHECK(usable >= size && usable <= 4 * (size + align), "%zu B at %zu: %zu B usable", size, align, usable);
+        char *grown = v_realloc(ptr, size + 200 * KB);
+        CHECK(grown && grown[size - 1] == 7, "%zu B at %zu: realloc lost the contents", size, align);
+        v_free(grown);
+    }
+}
+
+// MARK: pool cache
+// a released cache hands every slot back to the pool, frees into its chunks from other caches included,
+// so another cache reuses all of them before it claims a new chunk
+static void test_pool_cache_release(void) {
+    enum { count = 10000 };
+    static void *objs[count];
+    VPool pool;
+    if (!v_pool_init_shared(&pool, 48, 256 * MB)) {
+        CHECK(false, "v_pool_init_shared failed");
+        return;
+    }
+    VPoolCache owner, other;
+    v_pool_cache_init(&owner, &pool);
+    v_pool_cache_init(&other, &pool);
+    for (int i = 0; i < count; i++) {
+        objs[i] = v_pool_cache_alloc(&owner);
+    }
+    size_t claimed = (size_t)(pool.alloc_info.ptr - pool.alloc_info.base);
+    // half freed before the release lands in owner's remote list, half after goes to the pool directly
+    for (int i = 0; i < count / 2; i++) {
+        v_pool_cache_free(&other, objs[i]);
+    }
+    v_pool_cache_release(&owner);
+    for (int i = count / 2; i < count; i++) {
+        v_pool_cache_free(&other, objs[i]);
+    }
+    size_t reused = 0;
+    while ((size_t)(pool.alloc_info.ptr - pool.alloc_info.base) == claimed && v_pool_cache_alloc(&other)) {
+        reused++;
+    }
+    size_t slots = claimed / pool.chunk_size * (pool.chunk_size / pool.elem_size);
+    CHECK(reused >= slots, "pool cache release: %zu of %zu slots reused", reused, slots);
+    v_pool_cache_release(&other);
+    v_pool_release(&pool);
+}
+
+// MARK: threads
+#define THREAD_OPS (256 * 1024)
+#define THREAD_SIZE 64
+
+typedef struct ThreadArgs {
+    AllocInfo *shared; // NULL pushes to an arena per thread
+    TestBarrier *start;
+    uint32_t tag;
+    double elapsed_ns;
+    size_t failed;
+} ThreadArgs;
+
+static void test_thread(void *arg) {
+    ThreadArgs *args = arg;
+    AllocInfo local = {0};
+    v_alloc_set_commit_policy(&local, 64 * KB, 4 * MB);
+    test_barrier_wait(args->start);
+    double start_ns = test_now_ns();
+    for (size_t i = 0; i < THREAD_OPS; i++) {
+        uint32_t *ptr = args->shared ? v_alloc_committ_shared(args->shared, THREAD_SIZE)
+                                     : v_alloc_committ(&local, THREAD_SIZE);
+        if (!ptr) {
+            args->failed++;
+            continue;
+        }
+        ptr[0] = args->tag;
+    }
+    args->elapsed_ns = test_now_ns() - start_ns;
+    v_alloc_free(&local);
+}
+// wall time of the slowest thread, every thread doing THREAD_OPS pushes
+static double test_threads(AllocInfo *shared, int thread_count) {
+    TestThread threads[64];
+    ThreadArgs args[64];
+    TestBarrier start;
+    test_barrier_init(&start, thread_count);
+    for (int i = 0; i < thread_count; i++) {
+        args[i] = (ThreadArgs){ shared, &start, (uint32_t)i + 1, 0, 0 };
+        if (!test_thread_start(&threads[i], test_thread, &args[i])) {
+            printf("FAIL: can't start thread %d of %d\n", i + 1, thread_count);
+            exit(1); // the started ones wait at the barrier for good
+        }
+    }
+    double elapsed_ns = 0;
+    for (int i = 0; i < thread_count; i++) {
+        test_thread_join(threads[i]);
+        CHECK(args[i].failed == 0, "%d threads: %zu failed pushes", thread_count, args[i].failed);
+        elapsed_ns = args[i].elapsed_ns > elapsed_ns ? args[i].elapsed_ns : elapsed_ns;
+    }
+    test_barrier_destroy(&start);
+    return elapsed_ns;
+}
+// every block of the shared arena was handed out exactly once: each one carries a tag and
+// every thread's tag appears THREAD_OPS times
+static void test_shared_blocks(AllocInfo *shared, int thread_count) {
+    size_t counts[65] = {0};
+    size_t used = shared->ptr - shared->base;
+    CHECK(used == (size_t)thread_count * THREAD_OPS * THREAD_SIZE, "%d threads: %zu B used", thread_count, used);
+    for (size_t offset = 0; offset + THREAD_SIZE <= used; offset += THREAD_SIZE) {
+        uint32_t tag = *(uint32_t *)(shared->base + offset);
+        if (tag == 0 || tag > (uint32_t)thread_count) {
+            CHECK(tag != 0 && tag <= (uint32_t)thread_count, "%d threads: block at %zu not handed out", thread_count, offset);
+            return;
+        }
+        counts[tag]++;
+    }
+    for (int i = 1; i <= thread_count; i++) {
+        CHECK(counts[i] == THREAD_OPS, "%d threads: thread %d got %zu blocks", thread_count, i, counts[i]);
+    }
+}
+// one run of thread_count threads on a fresh shared arena, checked for blocks and commits
+static double test_shared_run(int thread_count) {
+    AllocInfo shared = { .backend = &test_backend };
+    CHECK(v_alloc_reserve(&shared, 2 * GB), "reserve");
+    v_alloc_set_commit_policy(&shared, 64 * KB, 4 * MB);
+    test_commit_calls = 0;
+    double elapsed_ns = test_threads(&shared, thread_count);
+    test_shared_blocks(&shared, thread_count);
+    size_t used = shared.ptr - shared.base;
+    size_t expected = test_expected_commits(used, 64 * KB, 4 * MB);
+    CHECK(test_commit_calls <= expected, "%d threads: %zu shared commits, expected at most %zu",
+          thread_count, test_commit_calls, expected);
+    v_alloc_free(&shared);
+    return elapsed_ns;
+}
+// best of a few runs, a single descheduled thread mustn't decide a timing check
+#define TEST_TIMING_RUNS 3
+static double test_best(bool shared, int thread_count, bool timed) {
+    double best = 0;
+    for (int run = 0; run < (timed ? TEST_TIMING_RUNS : 1); run++) {
+        double elapsed_ns = shared ? test_shared_run(thread_count) : test_threads(NULL, thread_count);
+        best = run == 0 || elapsed_ns < best ? elapsed_ns : best;
+    }
+    return best;
+}
+// the shared bump path has every thread on one cache line, so it can't scale linearly, but the threads
+// together must push at least as fast as a single thread: n threads doing n times the work take at most
+// n times as long. arenas per thread share nothing and have to scale close to linearly. timings are only
+// compared while each thread has a core of its own
+static void test_scaling(void) {
+    long cpus = test_cpu_count();
+    double shared_one = 0;
+    double local_one = 0;
+    for (int thread_count = 1; thread_count <= 64; thread_count *= 2) {
+        bool timed = thread_count <= cpus && cpus > 1;
+        double shared_ns = test_best(true, thread_count, timed);
+        double local_ns = test_best(false, thread_count, timed);
+        printf("%2d threads: shared %6.2f ns/op, per thread arenas %6.2f ns/op\n", thread_count,
+               shared_ns / ((double)thread_count * THREAD_OPS), local_ns / ((double)thread_count * THREAD_OPS));
+        if (thread_count == 1) {
+            shared_one = shared_ns;
+            local_one = local_ns;
+        } else if (timed) {
+            CHECK(shared_ns <= thread_count * shared_one,
+                  "%d threads: shared arena pushed %.1f Mops/s, one thread %.1f Mops/s", thread_count,
+                  thread_count * THREAD_OPS * 1e3 / shared_ns, THREAD_OPS * 1e3 / shared_one);
+            CHECK(local_ns < 2 * local_one, "%d threads: per thread arenas took %.0f ns against %.0f ns on one",
+                  thread_count, local_ns, local_one);
+        }
+    }
+    if (cpus < 2) {
+        printf("one cpu online, scaling timings not checked\n");
+    }
+}
+
+int main(void) {
+    test_backend = v_alloc;
+    test_backend.commit = test_commit;
+    test_backend.decommit = test_decommit;
+#ifdef V_ALLOC_DEBUG
+    printf("V_ALLOC_DEBUG commits and decommits around every push, build without it\n");
+    return 1;
+#endif
+    size_t sizes[] = { 16, 64, 256, 4096 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        test_commit_count(100 * 1000, sizes[i], 64 * KB, 0);
+        test_commit_count(100 * 1000, sizes[i], 64 * KB, 64 * MB);
+    }
+    test_reset_refaults(0, 16 * MB, 4, "keep all");
+    test_reset_refaults(16 * MB, 16 * MB, 4, "retain 16 MiB");
+    test_reset_refaults(64 * KB, 16 * MB, 4, "retain 64 KiB, steady peak");
+    test_realloc_base();
+    test_malloc_aligned();
+    test_pool_cache_release();
+    test_scaling();
+    printf("%s: %d failed\n", test_failures ? "FAIL" : "ok", test_failures);
+    return test_failures != 0;
+}
@@ -2,10 +2,14 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifndef MAX
 #define MAX(x, y) ((x) >= (y) ? (x) : (y))
 #endif
+#ifndef MIN
+#define MIN(x, y) ((x) <= (y) ? (x) : (y))
+#endif
 
 #define ALIGN_DOWN(n, a) ((n) & ~((a) - 1))
 #define ALIGN_UP(n, a) ALIGN_DOWN((n) + (a) - 1, (a))
@@ -13,6 +17,27 @@
 #define ALIGN_DOWN_PTR(p, a) ((void *)ALIGN_DOWN((uintptr_t)(p), (a)))
 #define ALIGN_UP_PTR(p, a) ((void *)ALIGN_UP((uintptr_t)(p), (a)))
 
+#define V_ALLOC_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+#define V_ALLOC_GIANT_PAGE_SIZE ((size_t)1024 * 1024 * 1024)
+
+#if defined(_MSC_VER)
+    #define V_THREAD_LOCAL __declspec(thread)
+#else
+    #define V_THREAD_LOCAL _Thread_local
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+    #define V_COLD __attribute__((cold, noinline))
+#elif defined(_MSC_VER)
+    #define V_COLD __declspec(noinline)
+#else
+    #define V_COLD
+#endif
+#ifdef V_ALLOC_DEBUG // freed slots are poisoned after the free list link
+    #define V_POISON_SLOT(ptr, size) memset((char *)(ptr) + sizeof(void *), V_ALLOC_POISON, (size) - sizeof(void *))
+#else
+    #define V_POISON_SLOT(ptr, size) ((void)0)
+#endif
+
 typedef int8_t      s8; 
 typedef int16_t     s16;
 typedef int32_t     s32;
@@ -22,29 +47,27 @@ typedef uint16_t    u16;
 typedef uint32_t    u32;
 typedef uint64_t    u64;
 
-typedef struct {
-    void *(*reserve)(size_t size);   
-    bool (*commit)(void *addr, size_t total_size, size_t additional_bytes);    
-    bool (*decommit)(void *addr, size_t size);  
-    bool (*release)(void *addr, size_t size);  
-    size_t page_size;               // System page size
-} V_Allocator;
+// backend of an arena, alloc_info->backend or the os default
+#define V_BACKEND(alloc_info) ((alloc_info)->backend ? (alloc_info)->backend : &v_alloc)
 
 // MARK: WIN32
 #if defined(_WIN32)
     #define WIN32_LEAN_AND_MEAN
     #include <windows.h>
+    #include <winioctl.h>
 
-    static void *v_alloc_win_reserve(size_t size);
+    static void *v_alloc_win_reserve(size_t size, unsigned *flags, size_t *page_size);
     static bool v_alloc_win_commit(void *addr, size_t total_size, size_t additional_bytes);
     static bool v_alloc_win_decommit(void *addr, size_t size);
     static bool v_alloc_win_release(void *addr, size_t size);
+    static bool v_alloc_win_prefault(void *addr, size_t size);
 
     V_Allocator v_alloc = {
         .reserve = v_alloc_win_reserve,
         .commit = v_alloc_win_commit,
         .decommit = v_alloc_win_decommit,
         .release = v_alloc_win_release,
+        .prefault = v_alloc_win_prefault,
         .page_size = 0,
     };
     static size_t v_alloc_win_get_page_size(){
@@ -52,10 +75,26 @@ typedef struct {
         GetSystemInfo(&sys_info);
         return (size_t)sys_info.dwPageSize;
     }
-    static void *v_alloc_win_reserve(size_t size) {
+    static void *v_alloc_win_reserve(size_t size, unsigned *flags, size_t *page_size) {
         if(v_alloc.page_size == 0){
             v_alloc.page_size = v_alloc_win_get_page_size();
         }
+        *page_size = v_alloc.page_size;
+        if (*flags & (V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G)) {
+            // large pages can't be reserved and committed separately and need SeLockMemoryPrivilege,
+            // so the whole range is committed up front. without the privilege this fails and we fall back
+            size_t large_page_size = GetLargePageMinimum();
+            if (large_page_size) {
+                void *ptr = VirtualAlloc(NULL, ALIGN_UP(size, large_page_size), 
+                                         MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+                if (ptr) {
+                    *flags = (*flags & ~V_ALLOC_HUGE_1G) | V_ALLOC_HUGE_PAGES | V_ALLOC_PRECOMMITTED;
+                    *page_size = large_page_size;
+                    return ptr;
+                }
+            }
+            *flags &= ~(V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G);
+        }
         return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
     }
     static bool v_alloc_win_commit(void *addr, size_t total_size, size_t additional_bytes) {
@@ -64,36 +103,207 @@ typedef struct {
         return result ? true : false;
     }
     static bool v_alloc_win_decommit(void *addr, size_t extra_size) {
-        // VirtualFree(base_addr + 1MB, MEM_DECOMMIT, extra_size);
+        // VirtualFree(base_addr + 1MB, extra_size, MEM_DECOMMIT);
     /* 
         "The VirtualFree function can decommit a range of pages that are in 
         different states, some committed and some uncommitted. This means 
         that you can decommit a range of pages without first determining 
         the current commitment state of each page."
     */
-        BOOL success = VirtualFree(addr, MEM_DECOMMIT, (DWORD)extra_size);
+        BOOL success = VirtualFree(addr, extra_size, MEM_DECOMMIT);
         return success ? true : false;
     }
     static bool v_alloc_win_release(void *addr, size_t size) {
         (void)size; 
         return VirtualFree(addr, 0, MEM_RELEASE);
     }
+    // PrefetchVirtualMemory only reads in pages that have a backing store, freshly committed memory
+    // is demand zero and has to be touched. reads and writes back each page so existing contents stay
+    static bool v_alloc_win_prefault(void *addr, size_t size) {
+        for (size_t offset = 0; offset < size; offset += v_alloc.page_size) {
+            volatile char *page = (volatile char *)addr + offset;
+            *page = *page;
+        }
+        return true;
+    }
+
+    // the file is opened as a sparse file and mapped at its full reserve size up front, windows
+    // grows the file to the mapping size. on close it's cut back to the bytes in use
+    static bool v_alloc_win_file_open(AllocInfo *alloc_info, const char *path, size_t reserve_size, size_t *file_size) {
+        if(v_alloc.page_size == 0){
+            v_alloc.page_size = v_alloc_win_get_page_size();
+        }
+        HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return false;
+        }
+        *file_size = (size_t)size.QuadPart;
+        reserve_size = ALIGN_UP(MAX(reserve_size, *file_size), v_alloc.page_size);
+        DWORD bytes_returned;
+        DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytes_returned, NULL); // best effort
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((u64)reserve_size >> 32), 
+                                            (DWORD)reserve_size, NULL);
+        void *base = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, reserve_size) : NULL;
+        if (!base) {
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            return false;
+        }
+        alloc_info->base = base;
+        alloc_info->reserved_size = reserve_size;
+        alloc_info->page_size = v_alloc.page_size;
+        alloc_info->file = (intptr_t)file;
+        alloc_info->file_mapping = (intptr_t)mapping;
+        return true;
+    }
+    // the whole view is already readable and writable
+    static bool v_alloc_win_file_commit(AllocInfo *alloc_info, size_t total_size) {
+        (void)alloc_info;
+        (void)total_size;
+        return true;
+    }
+    static bool v_alloc_win_file_close(AllocInfo *alloc_info, size_t used_size) {
+        bool result = UnmapViewOfFile(alloc_info->base) ? true : false;
+        CloseHandle((HANDLE)alloc_info->file_mapping);
+        LARGE_INTEGER size;
+        size.QuadPart = (LONGLONG)used_size;
+        if (!SetFilePointerEx((HANDLE)alloc_info->file, size, NULL, FILE_BEGIN) || !SetEndOfFile((HANDLE)alloc_info->file)) {
+            result = false;
+        }
+        CloseHandle((HANDLE)alloc_info->file);
+        return result;
+    }
+    #define v_alloc_file_open v_alloc_win_file_open
+    #define v_alloc_file_commit v_alloc_win_file_commit
+    #define v_alloc_file_close v_alloc_win_file_close
+
+    // the preferred node is taken when the range is reserved, commits into an existing reservation don't
+    // apply it again. so the node is named at reserve time and the arena commits as usual
+    static void *v_alloc_win_node_reserve(size_t size, unsigned node, unsigned *flags, size_t *page_size) {
+        if(v_alloc.page_size == 0){
+            v_alloc.page_size = v_alloc_win_get_page_size();
+        }
+        *page_size = v_alloc.page_size;
+        if (*flags & (V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G)) { // committed up front, see v_alloc_win_reserve
+            size_t large_page_size = GetLargePageMinimum();
+            if (large_page_size) {
+                void *ptr = VirtualAllocExNuma(GetCurrentProcess(), NULL, ALIGN_UP(size, large_page_size),
+                                               MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+                if (ptr) {
+                    *flags = (*flags & ~V_ALLOC_HUGE_1G) | V_ALLOC_HUGE_PAGES | V_ALLOC_PRECOMMITTED;
+                    *page_size = large_page_size;
+                    return ptr;
+                }
+            }
+            *flags &= ~(V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G);
+        }
+        return VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE, PAGE_NOACCESS, node);
+    }
+    static unsigned v_alloc_win_node_count(void) {
+        ULONG highest;
+        return GetNumaHighestNodeNumber(&highest) ? (unsigned)highest + 1 : 1;
+    }
+    static unsigned v_alloc_win_current_node(void) {
+        PROCESSOR_NUMBER processor;
+        USHORT node;
+        GetCurrentProcessorNumberEx(&processor);
+        return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+    }
+    #define v_alloc_node_reserve v_alloc_win_node_reserve
+    #define v_alloc_node_count v_alloc_win_node_count
+    #define v_alloc_current_node v_alloc_win_current_node
+
+    // two views of one section into the two halves of a split placeholder reservation, needs windows 10
+    // 1803 for VirtualAlloc2 / MapViewOfFile3. size has to be a multiple of the allocation granularity
+    #pragma comment(lib, "onecore.lib")
+    static size_t v_alloc_win_ring_granularity(void) {
+        SYSTEM_INFO sys_info;
+        GetSystemInfo(&sys_info);
+        return sys_info.dwAllocationGranularity;
+    }
+    static char *v_alloc_win_ring_map(size_t size, intptr_t *handle) {
+        HANDLE section = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((u64)size >> 32),
+                                            (DWORD)size, NULL);
+        if (!section) {
+            return NULL;
+        }
+        char *base = VirtualAlloc2(NULL, NULL, 2 * size, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, NULL, 0);
+        if (!base) {
+            CloseHandle(section);
+            return NULL;
+        }
+        VirtualFree(base, size, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER); // split into two placeholders
+        void *first = MapViewOfFile3(section, NULL, base, 0, size, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, NULL, 0);
+        void *second = MapViewOfFile3(section, NULL, base + size, 0, size, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, NULL, 0);
+        if (!first || !second) {
+            if (first) {
+                UnmapViewOfFile(first);
+            } else {
+                VirtualFree(base, 0, MEM_RELEASE);
+            }
+            if (second) {
+                UnmapViewOfFile(second);
+            } else {
+                VirtualFree(base + size, 0, MEM_RELEASE);
+            }
+            CloseHandle(section);
+            return NULL;
+        }
+        *handle = (intptr_t)section;
+        return base;
+    }
+    static void v_alloc_win_ring_unmap(char *base, size_t size, intptr_t handle) {
+        UnmapViewOfFile(base);
+        UnmapViewOfFile(base + size);
+        CloseHandle((HANDLE)handle);
+    }
+    #define v_alloc_ring_granularity v_alloc_win_ring_granularity
+    #define v_alloc_ring_map v_alloc_win_ring_map
+    #define v_alloc_ring_unmap v_alloc_win_ring_unmap
+
+    // there's no fork on windows, only the default policy exists
+    static bool v_alloc_win_fork_advise(void *addr, size_t size, unsigned policy) {
+        (void)addr;
+        (void)size;
+        return policy == 0;
+    }
+    static bool v_alloc_win_protect(void *addr, size_t size, bool read_only) {
+        DWORD old_protect;
+        return VirtualProtect(addr, size, read_only ? PAGE_READONLY : PAGE_READWRITE, &old_protect) ? true : false;
+    }
+    #define v_alloc_fork_advise v_alloc_win_fork_advise
+    #define v_alloc_protect v_alloc_win_protect
 
    // MARK: LINUX
 #elif defined(__linux__) || defined(__APPLE__)
+    #include <fcntl.h>
     #include <unistd.h>
     #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <stdio.h>
+    #if defined(__linux__)
+        #include <sys/syscall.h>
+    #endif
 
-    static void *v_alloc_posix_reserve(size_t size);
+    static void *v_alloc_posix_reserve(size_t size, unsigned *flags, size_t *page_size);
     static bool v_alloc_posix_commit(void *addr, size_t total_size, size_t additional_bytes);
     static bool v_alloc_posix_decommit(void *addr, size_t extra_size);
     static bool v_alloc_posix_release(void *addr, size_t size);
+    static bool v_alloc_posix_prefault(void *addr, size_t size);
 
     V_Allocator v_alloc = {
         .reserve = v_alloc_posix_reserve,
         .commit = v_alloc_posix_commit,
         .decommit = v_alloc_posix_decommit,
         .release = v_alloc_posix_release,
+        .prefault = v_alloc_posix_prefault,
         .page_size = 0,
     };
     static size_t v_alloc_posix_get_page_size(){
@@ -104,17 +314,67 @@ typedef struct {
         }
         return (size_t)page_size;
     }
-    static void *v_alloc_posix_reserve(size_t size) {
+    #if defined(MAP_HUGETLB) && !defined(MAP_HUGE_1GB)
+        #define MAP_HUGE_1GB (30 << 26) // log2(1 GiB) << MAP_HUGE_SHIFT
+    #endif
+    // transparent huge pages: align the reservation to 2 MiB so whole huge pages fit, then opt in
+    static void *v_alloc_posix_reserve_thp(size_t size) {
+    #if defined(MADV_HUGEPAGE)
+        size_t len = ALIGN_UP(size, V_ALLOC_HUGE_PAGE_SIZE);
+        char *raw = mmap(NULL, len + V_ALLOC_HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+        char *ptr = ALIGN_UP_PTR(raw, V_ALLOC_HUGE_PAGE_SIZE);
+        if (ptr > raw) {
+            munmap(raw, ptr - raw);
+        }
+        munmap(ptr + len, raw + V_ALLOC_HUGE_PAGE_SIZE - ptr);
+        if (madvise(ptr, len, MADV_HUGEPAGE) != 0) {
+            munmap(ptr, len); // thp disabled or unsupported
+            return NULL;
+        }
+        return ptr;
+    #else
+        (void)size;
+        return NULL;
+    #endif
+    }
+    static void *v_alloc_posix_reserve(size_t size, unsigned *flags, size_t *page_size) {
         if (v_alloc.page_size == 0) {
             v_alloc.page_size = v_alloc_posix_get_page_size();
         }
-        void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        *page_size = v_alloc.page_size;
+        void *ptr;
+    #if defined(MAP_HUGETLB)
+        if (*flags & V_ALLOC_HUGE_1G) {
+            // hugetlb pages for a private mapping are reserved at mmap time, so this fails
+            // up front instead of faulting later when the pool runs dry
+            ptr = mmap(NULL, ALIGN_UP(size, V_ALLOC_GIANT_PAGE_SIZE), PROT_NONE, 
+                       MAP_PRIVATE | MAP_ANON | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                *page_size = V_ALLOC_GIANT_PAGE_SIZE;
+                return ptr;
+            }
+            *flags = (*flags & ~V_ALLOC_HUGE_1G) | V_ALLOC_HUGE_PAGES;
+        }
+    #endif
+        if (*flags & (V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G)) {
+            ptr = v_alloc_posix_reserve_thp(size);
+            if (ptr) {
+                *flags = (*flags & ~V_ALLOC_HUGE_1G) | V_ALLOC_HUGE_PAGES;
+                *page_size = V_ALLOC_HUGE_PAGE_SIZE;
+                return ptr;
+            }
+            *flags &= ~(V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G);
+        }
+        ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
         return ptr == MAP_FAILED ? NULL : ptr;
     }
     static bool v_alloc_posix_commit(void *addr, size_t total_size, size_t additional_bytes) {
         addr = (char *)addr + total_size - additional_bytes;
         s32 result = mprotect(addr, additional_bytes, PROT_READ | PROT_WRITE);
-        return result ? true : false;
+        return result == 0;
     }
     static bool v_alloc_posix_decommit(void *addr, size_t extra_size) {
         s32 result = madvise(addr, extra_size, MADV_DONTNEED);
@@ -126,151 +386,1915 @@ typedef struct {
     static bool v_alloc_posix_release(void *addr, size_t size) {
         return munmap(addr, size) == 0 ? true : false;
     }
+    #if defined(__linux__) && !defined(MADV_POPULATE_WRITE)
+        #define MADV_POPULATE_WRITE 23 // linux 5.14, older kernels fail with EINVAL
+    #endif
+    static bool v_alloc_posix_prefault(void *addr, size_t size) {
+    #if defined(__linux__)
+        if (madvise(addr, size, MADV_POPULATE_WRITE) == 0) {
+            return true;
+        }
+    #endif
+        // touch every page, read and write back so existing contents stay
+        for (size_t offset = 0; offset < size; offset += v_alloc.page_size) {
+            volatile char *page = (volatile char *)addr + offset;
+            *page = *page;
+        }
+        return true;
+    }
+    // shared mapping of the whole reserve size, pages past the end of the file stay PROT_NONE
+    // until a commit extends the file over them
+    static bool v_alloc_posix_file_open(AllocInfo *alloc_info, const char *path, size_t reserve_size, size_t *file_size) {
+        if (v_alloc.page_size == 0) {
+            v_alloc.page_size = v_alloc_posix_get_page_size();
+        }
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        *file_size = (size_t)st.st_size;
+        reserve_size = ALIGN_UP(MAX(reserve_size, *file_size), v_alloc.page_size);
+        void *base = mmap(NULL, reserve_size, PROT_NONE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        alloc_info->base = base;
+        alloc_info->reserved_size = reserve_size;
+        alloc_info->page_size = v_alloc.page_size;
+        alloc_info->file = fd;
+        return true;
+    }
+    static bool v_alloc_posix_file_commit(AllocInfo *alloc_info, size_t total_size) {
+        if (ftruncate((int)alloc_info->file, (off_t)total_size) != 0) {
+            return false;
+        }
+        return mprotect(alloc_info->base, total_size, PROT_READ | PROT_WRITE) == 0;
+    }
+    static bool v_alloc_posix_file_close(AllocInfo *alloc_info, size_t used_size) {
+        bool result = munmap(alloc_info->base, alloc_info->reserved_size) == 0;
+        if (ftruncate((int)alloc_info->file, (off_t)used_size) != 0) {
+            result = false;
+        }
+        close((int)alloc_info->file);
+        return result;
+    }
+    #define v_alloc_file_open v_alloc_posix_file_open
+    #define v_alloc_file_commit v_alloc_posix_file_commit
+    #define v_alloc_file_close v_alloc_posix_file_close
+
+    #if defined(__linux__)
+        // mbind sets the policy of the whole reserved range, it holds for pages faulted in after
+        // every later commit and survives decommits. no libnuma needed
+        #define V_MPOL_BIND 2
+        static bool v_alloc_posix_node_bind(void *addr, size_t size, unsigned node) {
+            unsigned long mask[(V_ALLOC_NUMA_MAX + 63) / 64] = {0};
+            if (node >= V_ALLOC_NUMA_MAX) {
+                return false;
+            }
+            mask[node / 64] = 1ul << (node % 64);
+            return syscall(SYS_mbind, addr, size, V_MPOL_BIND, mask, (unsigned long)V_ALLOC_NUMA_MAX + 1, 0) == 0;
+        }
+        static unsigned v_alloc_posix_node_count(void) {
+            unsigned count = 1;
+            char path[64];
+            for (unsigned node = 1; node < V_ALLOC_NUMA_MAX; node++) {
+                snprintf(path, sizeof(path), "/sys/devices/system/node/node%u", node);
+                if (access(path, F_OK) == 0) {
+                    count = node + 1;
+                }
+            }
+            return count;
+        }
+        static unsigned v_alloc_posix_current_node(void) {
+            unsigned cpu, node;
+            return syscall(SYS_getcpu, &cpu, &node, NULL) == 0 ? node : 0;
+        }
+    #else // macOS has no numa api, everything is node 0
+        static bool v_alloc_posix_node_bind(void *addr, size_t size, unsigned node) {
+            (void)addr;
+            (void)size;
+            return node == 0;
+        }
+        static unsigned v_alloc_posix_node_count(void) {
+            return 1;
+        }
+        static unsigned v_alloc_posix_current_node(void) {
+            return 0;
+        }
+    #endif
+    // nothing to bind on a single node machine, kernels without numa support fail mbind
+    static void *v_alloc_posix_node_reserve(size_t size, unsigned node, unsigned *flags, size_t *page_size) {
+        void *ptr = v_alloc_posix_reserve(size, flags, page_size);
+        if (ptr && v_alloc_posix_node_count() > 1 && !v_alloc_posix_node_bind(ptr, size, node)) {
+            v_alloc_posix_release(ptr, size);
+            return NULL;
+        }
+        return ptr;
+    }
+    #define v_alloc_node_reserve v_alloc_posix_node_reserve
+    #define v_alloc_node_count v_alloc_posix_node_count
+    #define v_alloc_current_node v_alloc_posix_current_node
+
+    // anonymous shared memory mapped twice over a reservation of twice its size. the fd is closed
+    // right away, the mappings keep the memory alive
+    static int v_alloc_posix_ring_fd(void) {
+    #if defined(__linux__)
+        return (int)syscall(SYS_memfd_create, "v_ring", 1u /* MFD_CLOEXEC */);
+    #else
+        char name[64];
+        snprintf(name, sizeof(name), "/v_ring.%d.%p", (int)getpid(), (void *)name);
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0) {
+            shm_unlink(name);
+        }
+        return fd;
+    #endif
+    }
+    static size_t v_alloc_posix_ring_granularity(void) {
+        return v_alloc_posix_get_page_size();
+    }
+    static char *v_alloc_posix_ring_map(size_t size, intptr_t *handle) {
+        int fd = v_alloc_posix_ring_fd();
+        if (fd < 0) {
+            return NULL;
+        }
+        char *base = NULL;
+        if (ftruncate(fd, (off_t)size) == 0) {
+            base = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            if (base == MAP_FAILED) {
+                base = NULL;
+            } else if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+                       mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                munmap(base, 2 * size);
+                base = NULL;
+            }
+        }
+        close(fd);
+        *handle = -1;
+        return base;
+    }
+    static void v_alloc_posix_ring_unmap(char *base, size_t size, intptr_t handle) {
+        (void)handle;
+        munmap(base, 2 * size);
+    }
+    #define v_alloc_ring_granularity v_alloc_posix_ring_granularity
+    #define v_alloc_ring_map v_alloc_posix_ring_map
+    #define v_alloc_ring_unmap v_alloc_posix_ring_unmap
+
+    #if defined(__linux__)
+        #ifndef MADV_WIPEONFORK
+            #define MADV_WIPEONFORK 18 // linux 4.14
+            #define MADV_KEEPONFORK 19
+        #endif
+        // each call sets one policy and clears the other
+        static bool v_alloc_posix_fork_advise(void *addr, size_t size, unsigned policy) {
+            int wipe = (policy & V_ALLOC_FORK_WIPE) ? MADV_WIPEONFORK : MADV_KEEPONFORK;
+            int skip = (policy & V_ALLOC_FORK_SKIP) ? MADV_DONTFORK : MADV_DOFORK;
+            return madvise(addr, size, wipe) == 0 && madvise(addr, size, skip) == 0;
+        }
+    #else // macOS can leave a range out of the child but not zero it
+        #include <mach/vm_inherit.h>
+        static bool v_alloc_posix_fork_advise(void *addr, size_t size, unsigned policy) {
+            if (policy & V_ALLOC_FORK_WIPE) {
+                return false;
+            }
+            int inherit = (policy & V_ALLOC_FORK_SKIP) ? VM_INHERIT_NONE : VM_INHERIT_COPY;
+            return minherit(addr, size, inherit) == 0;
+        }
+    #endif
+    static bool v_alloc_posix_protect(void *addr, size_t size, bool read_only) {
+        return mprotect(addr, size, read_only ? PROT_READ : PROT_READ | PROT_WRITE) == 0;
+    }
+    #define v_alloc_fork_advise v_alloc_posix_fork_advise
+    #define v_alloc_protect v_alloc_posix_protect
 #else
     #error "Unsupported platform"
 #endif
 // /////////////////////////////////////////////
+// MARK: atomics
+// /////////////////////////////////////////////
+#if defined(_MSC_VER)
+    #define V_CPU_RELAX() YieldProcessor()
+    static inline char *v_atomic_load_ptr(char **p) { 
+        return (char *)ReadPointerAcquire((PVOID const volatile *)p); 
+    }
+    static inline void v_atomic_store_ptr(char **p, char *v) { 
+        WritePointerRelease((PVOID volatile *)p, v); 
+    }
+    static inline char *v_atomic_fetch_add_ptr(char **p, size_t n) { 
+        return (char *)InterlockedExchangeAddSizeT((SIZE_T volatile *)p, n); 
+    }
+    static inline bool v_atomic_try_lock(long *lock) { 
+        return InterlockedCompareExchange((LONG volatile *)lock, 1, 0) == 0; 
+    }
+    static inline bool v_atomic_is_locked(long *lock) { 
+        return ReadAcquire((LONG const volatile *)lock) != 0; 
+    }
+    static inline void v_atomic_unlock(long *lock) { 
+        WriteRelease((LONG volatile *)lock, 0); 
+    }
+    static inline void *v_atomic_exchange_ptr(void **p, void *v) { 
+        return InterlockedExchangePointer((PVOID volatile *)p, v); 
+    }
+    static inline void v_atomic_add_size(size_t *p, size_t n) { 
+        InterlockedExchangeAddSizeT((SIZE_T volatile *)p, n); 
+    }
+    static inline void v_atomic_max_size(size_t *p, size_t v) {
+        size_t cur = *(size_t volatile *)p;
+        while (cur < v) {
+            size_t prev = (size_t)InterlockedCompareExchangePointer((PVOID volatile *)p, (PVOID)v, (PVOID)cur);
+            if (prev == cur) {
+                break;
+            }
+            cur = prev;
+        }
+    }
+    static inline long v_atomic_load_long(long *p) { 
+        return ReadAcquire((LONG const volatile *)p); 
+    }
+    static inline void v_atomic_store_long(long *p, long v) { 
+        WriteRelease((LONG volatile *)p, v); 
+    }
+    // on failure *expected is updated with the current value
+    static inline bool v_atomic_cas_ptr(void **p, void **expected, void *desired) {
+        void *prev = InterlockedCompareExchangePointer((PVOID volatile *)p, desired, *expected);
+        if (prev == *expected) {
+            return true;
+        }
+        *expected = prev;
+        return false;
+    }
+#else
+    #if defined(__x86_64__) || defined(__i386__)
+        #define V_CPU_RELAX() __builtin_ia32_pause()
+    #elif defined(__aarch64__) || defined(__arm__)
+        #define V_CPU_RELAX() __asm__ __volatile__("yield")
+    #else
+        #define V_CPU_RELAX() ((void)0)
+    #endif
+    static inline char *v_atomic_load_ptr(char **p) { 
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE); 
+    }
+    static inline void v_atomic_store_ptr(char **p, char *v) { 
+        __atomic_store_n(p, v, __ATOMIC_RELEASE); 
+    }
+    // pointer operands are not scaled by the pointee size, n is in bytes
+    static inline char *v_atomic_fetch_add_ptr(char **p, size_t n) { 
+        return __atomic_fetch_add(p, n, __ATOMIC_RELAXED); 
+    }
+    static inline bool v_atomic_try_lock(long *lock) { 
+        return __atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) == 0; 
+    }
+    static inline bool v_atomic_is_locked(long *lock) { 
+        return __atomic_load_n(lock, __ATOMIC_RELAXED) != 0; 
+    }
+    static inline void v_atomic_unlock(long *lock) { 
+        __atomic_store_n(lock, 0, __ATOMIC_RELEASE); 
+    }
+    static inline void *v_atomic_exchange_ptr(void **p, void *v) { 
+        return __atomic_exchange_n(p, v, __ATOMIC_ACQUIRE); 
+    }
+    static inline void v_atomic_add_size(size_t *p, size_t n) { 
+        __atomic_fetch_add(p, n, __ATOMIC_RELAXED); 
+    }
+    static inline void v_atomic_max_size(size_t *p, size_t v) {
+        size_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+        while (cur < v && !__atomic_compare_exchange_n(p, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+    static inline long v_atomic_load_long(long *p) { 
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE); 
+    }
+    static inline void v_atomic_store_long(long *p, long v) { 
+        __atomic_store_n(p, v, __ATOMIC_RELEASE); 
+    }
+    // on failure *expected is updated with the current value
+    static inline bool v_atomic_cas_ptr(void **p, void **expected, void *desired) {
+        return __atomic_compare_exchange_n(p, expected, desired, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+#endif
+// test and test-and-set spin lock, only held around commit syscalls
+static void v_atomic_lock(long *lock) {
+    while (!v_atomic_try_lock(lock)) {
+        while (v_atomic_is_locked(lock)) {
+            V_CPU_RELAX();
+        }
+    }
+}
+// /////////////////////////////////////////////
+// MARK: stats
+// /////////////////////////////////////////////
+#ifdef V_ALLOC_STATS
+    #define V_STAT(...) __VA_ARGS__
+    #if defined(_WIN32)
+        static u64 v_alloc_stats_now_ns(void) {
+            static LARGE_INTEGER frequency;
+            LARGE_INTEGER counter;
+            if (frequency.QuadPart == 0) {
+                QueryPerformanceFrequency(&frequency);
+            }
+            QueryPerformanceCounter(&counter);
+            return (u64)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+        }
+    #else
+        #include <time.h>
+        static u64 v_alloc_stats_now_ns(void) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+        }
+    #endif
+    // circular list of live arenas, the sentinel is never reported
+    static AllocInfo v_alloc_registry = { .stats_prev = &v_alloc_registry, .stats_next = &v_alloc_registry };
+    static long v_alloc_registry_lock;
+
+    static void v_alloc_stats_register(AllocInfo *alloc_info) {
+        v_atomic_lock(&v_alloc_registry_lock);
+        if (!alloc_info->stats_next) {
+            alloc_info->stats_prev = &v_alloc_registry;
+            alloc_info->stats_next = v_alloc_registry.stats_next;
+            v_alloc_registry.stats_next->stats_prev = alloc_info;
+            v_alloc_registry.stats_next = alloc_info;
+        }
+        v_atomic_unlock(&v_alloc_registry_lock);
+    }
+    static void v_alloc_stats_unregister(AllocInfo *alloc_info) {
+        v_atomic_lock(&v_alloc_registry_lock);
+        if (alloc_info->stats_next) {
+            alloc_info->stats_prev->stats_next = alloc_info->stats_next;
+            alloc_info->stats_next->stats_prev = alloc_info->stats_prev;
+            alloc_info->stats_prev = alloc_info->stats_next = NULL;
+        }
+        v_atomic_unlock(&v_alloc_registry_lock);
+    }
+    // relinks a registered AllocInfo that was copied from `from` to `to`
+    static void v_alloc_stats_move(AllocInfo *from, AllocInfo *to) {
+        v_atomic_lock(&v_alloc_registry_lock);
+        if (to->stats_next) {
+            to->stats_prev->stats_next = to;
+            to->stats_next->stats_prev = to;
+            from->stats_prev = from->stats_next = NULL;
+        }
+        v_atomic_unlock(&v_alloc_registry_lock);
+    }
+    // snapshot of the counters plus committed and reserved bytes. counters are
+    // plain fields, a snapshot of an arena in use may be slightly stale
+    bool v_alloc_stats_get(AllocInfo *alloc_info, AllocStats *stats) {
+        if (!alloc_info || !stats) {
+            return false;
+        }
+        *stats = alloc_info->stats;
+        stats->committed = alloc_info->end - alloc_info->base;
+        stats->reserved = alloc_info->reserved_size;
+        return true;
+    }
+    // calls fn for every live arena with the registry locked, fn must not reserve or free arenas
+    void v_alloc_stats_foreach(void (*fn)(AllocInfo *alloc_info, const AllocStats *stats, void *user), void *user) {
+        v_atomic_lock(&v_alloc_registry_lock);
+        for (AllocInfo *it = v_alloc_registry.stats_next; it != &v_alloc_registry; it = it->stats_next) {
+            AllocStats stats;
+            v_alloc_stats_get(it, &stats);
+            fn(it, &stats, user);
+        }
+        v_atomic_unlock(&v_alloc_registry_lock);
+    }
+#else
+    #define V_STAT(...)
+#endif
+// /////////////////////////////////////////////
 // /////////////////////////////////////////////
 // MARK: v_alloc
 // /////////////////////////////////////////////
 // /////////////////////////////////////////////
 
-// returns true on success, false on fail
+// returns true on success, false on fail. reserves with the flags already set on alloc_info
 bool v_alloc_reserve(AllocInfo *alloc_info, size_t reserve_size) {
-    alloc_info->base = (char*)v_alloc.reserve(reserve_size);
-    if (alloc_info->base == NULL) {
-        return false; // initialization failed
-    }
+    return v_alloc_reserve_ex(alloc_info, reserve_size, alloc_info->flags);
+}
+// huge page flags fall back to normal pages when the os can't provide them,
+// alloc_info->flags reports what was actually reserved
+// flags the caller may ask a reservation for
+static unsigned v_alloc_reserve_flags(unsigned flags) {
+    flags &= ~V_ALLOC_PRECOMMITTED;
+#ifdef V_ALLOC_DEBUG
+    flags &= ~(V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G); // guard pages need small pages
+#endif
+    return flags;
+}
+// sets up an arena over a fresh reservation
+static void v_alloc_reserve_init(AllocInfo *alloc_info, char *base, size_t reserve_size, unsigned flags, size_t page_size) {
+    alloc_info->base = base;
+    alloc_info->flags = flags;
     alloc_info->ptr = alloc_info->base;
     alloc_info->end = alloc_info->base; // because we're only reserving
-    alloc_info->reserved_size = reserve_size;
-    alloc_info->page_size = v_alloc.page_size;
+    alloc_info->reserved_size = ALIGN_UP(reserve_size, page_size);
+    alloc_info->page_size = page_size;
+    if (flags & V_ALLOC_PRECOMMITTED) {
+        alloc_info->end = alloc_info->base + alloc_info->reserved_size;
+    }
+    V_STAT(v_alloc_stats_register(alloc_info));
+}
+bool v_alloc_reserve_ex(AllocInfo *alloc_info, size_t reserve_size, unsigned flags) {
+    size_t page_size;
+    flags = v_alloc_reserve_flags(flags);
+    char *base = (char*)V_BACKEND(alloc_info)->reserve(reserve_size, &flags, &page_size);
+    if (base == NULL) {
+        return false; // initialization failed
+    }
+    v_alloc_reserve_init(alloc_info, base, reserve_size, flags, page_size);
     return true; 
 }
-// commits initial size or grows alloc_info by additional size, returns NULL on fail
-void* v_alloc_committ(AllocInfo *alloc_info, size_t additional_bytes) {
-    if(additional_bytes == 0){ // we will consider this an error
-        return NULL;
+// number of bytes to commit past end so that at least needed_size bytes are committed,
+// following the commit policy. returns 0 if the reservation can't hold needed_size
+static size_t v_alloc_commit_size(AllocInfo *alloc_info, size_t needed_size) {
+    if (needed_size > alloc_info->reserved_size) {
+        return 0;
     }
-    additional_bytes = ALIGN_UP(additional_bytes, V_ALLOC_ALIGNMENT);
-    if (additional_bytes > (size_t)(alloc_info->end - alloc_info->ptr)) {
-        if(alloc_info->base == 0){ // reserve default
-            if(!v_alloc_reserve(alloc_info, MAX_ARENA_CAPACITY)){
-                return NULL; // unable to reserve memory
-            }
-        }
-        // internally we align_up to page_size
-        size_t adjusted_additional_bytes = ALIGN_UP(additional_bytes, alloc_info->page_size);
-
-        if (alloc_info->ptr + adjusted_additional_bytes > alloc_info->base + alloc_info->reserved_size) {
-            return NULL; // out of reserved memory
-        }
-        size_t new_size = alloc_info->end - alloc_info->base + adjusted_additional_bytes;
-        int result = v_alloc.commit(alloc_info->base, new_size, adjusted_additional_bytes);
-        if (result == -1) {
-            return NULL; // failed commit
-        }
-        alloc_info->end = alloc_info->base + new_size;
+    size_t committed = alloc_info->end - alloc_info->base;
+    size_t available = ALIGN_DOWN(alloc_info->reserved_size - committed, alloc_info->page_size);
+    // internally we align_up to page_size
+    size_t grow = ALIGN_UP(needed_size - committed, alloc_info->page_size);
+    if (grow > available) {
+        return 0;
     }
-    void* ptr = alloc_info->ptr;
-    alloc_info->ptr = alloc_info->ptr + additional_bytes; 
-    return ptr; 
-}
-void v_alloc_reset(AllocInfo *alloc_info) {
-    // reset the pointer to the start of the committed region
-    // todo: decommit
-    if(alloc_info){
-        alloc_info->ptr = alloc_info->base;
+    size_t step = alloc_info->commit_chunk;
+    if (alloc_info->commit_max) { // geometric: grow by what is already committed, up to the cap
+        step = MIN(MAX(committed, step), alloc_info->commit_max);
     }
+    step = ALIGN_UP(step, alloc_info->page_size);
+    if (step > grow) {
+        grow = MIN(step, available);
+    }
+    return grow;
 }
-bool v_alloc_decommit(AllocInfo *alloc_info, size_t extra_size) {
-    if (!alloc_info || extra_size == 0) {
-        return false; // invalid input
+// commits pages so that at least needed_size bytes from base are usable, returns false on fail
+static bool v_alloc_commit_to(AllocInfo *alloc_info, size_t needed_size) {
+    size_t additional_bytes = v_alloc_commit_size(alloc_info, needed_size);
+    if (additional_bytes == 0) {
+        return false; // out of reserved memory
     }
-    // ensure extra_size is aligned to the page size
-    extra_size = ALIGN_UP(extra_size, alloc_info->page_size);
-    // ensure extra_size does not exceed the committed memory size
-    if (extra_size > (size_t)(alloc_info->end - alloc_info->base)) {
-        return false; // cannot decommit more memory than is committed
+    size_t new_size = alloc_info->end - alloc_info->base + additional_bytes;
+    V_STAT(u64 start_ns = v_alloc_stats_now_ns());
+    bool result;
+    if (alloc_info->flags & V_ALLOC_FILE) {
+        result = v_alloc_file_commit(alloc_info, new_size);
+    } else if (alloc_info->flags & V_ALLOC_NUMA) {
+        result = v_alloc.commit(alloc_info->base, new_size, additional_bytes); // bound at reserve time
+    } else {
+        result = V_BACKEND(alloc_info)->commit(alloc_info->base, new_size, additional_bytes);
     }
-    // ensure the decommit region is page-aligned
-    char *decommit_start = ALIGN_DOWN_PTR(alloc_info->end - extra_size, alloc_info->page_size);
-    // decommit the memory
-    bool result = v_alloc.decommit(decommit_start, extra_size);
-    if (result) {
-        alloc_info->end = decommit_start;
+    V_STAT(alloc_info->stats.commit_count++; alloc_info->stats.commit_ns += v_alloc_stats_now_ns() - start_ns);
+    if (!result) {
+        return false; // failed commit, end stays where it was
+    }
+    if ((alloc_info->flags & V_ALLOC_PREFAULT) && V_BACKEND(alloc_info)->prefault) { // optional in custom backends
+        V_BACKEND(alloc_info)->prefault(alloc_info->base + new_size - additional_bytes, additional_bytes);
+    }
+    v_atomic_store_ptr(&alloc_info->end, alloc_info->base + new_size); // published for v_alloc_committ_shared
+    return true;
+}
+// every change of end goes through commit_lock, the background committer may grow the arena concurrently.
+// readers of end outside the lock only ever see it too low and retry here
+static bool v_alloc_commit_locked(AllocInfo *alloc_info, size_t needed_size) {
+    v_atomic_lock(&alloc_info->commit_lock);
+    bool result = true;
+    if (needed_size > (size_t)(alloc_info->end - alloc_info->base)) { // not already committed by another thread
+        result = v_alloc_commit_to(alloc_info, needed_size);
     }
+    v_atomic_unlock(&alloc_info->commit_lock);
     return result;
 }
-bool v_alloc_free(AllocInfo* alloc_info) {
-    if (alloc_info->base == NULL) {
-        return false; // nothing to free
+// reserves with the flags already set on alloc_info and binds the range to a numa node, pages are
+// faulted in from that node no matter which thread touches them first
+bool v_alloc_reserve_node(AllocInfo *alloc_info, size_t reserve_size, unsigned node) {
+    if (alloc_info->backend || node >= v_alloc_node_count()) {
+        return false; // binding is done by the os, a custom backend owns its own placement
+    }
+    unsigned flags = v_alloc_reserve_flags(alloc_info->flags);
+    size_t page_size;
+    char *base = v_alloc_node_reserve(reserve_size, node, &flags, &page_size);
+    if (!base) {
+        return false;
     }
-    return v_alloc.release(alloc_info->base, alloc_info->reserved_size);
+    alloc_info->numa_node = node;
+    v_alloc_reserve_init(alloc_info, base, reserve_size, flags | V_ALLOC_NUMA, page_size);
+    return true;
 }
-
-
-typedef struct AllocHdr {  
-    AllocInfo alloc_info; 
-    _Alignas(V_ALLOC_ALIGNMENT) char data[];
-} AllocHdr;
-
-static inline AllocHdr *v_alloc_hdr_from_data(void *data) { 
-    return (AllocHdr*)((char*)(data) - offsetof(AllocHdr, data)); 
+// maps a file as the arena, creating it if needed. an existing file is treated as allocated: ptr starts
+// at its end so offsets from base stay valid across runs. commits extend the file, v_alloc_free cuts
+// it back to ptr - base. after a crash the file is left at the committed size
+bool v_alloc_reserve_file(AllocInfo *alloc_info, const char *path, size_t reserve_size) {
+    size_t file_size;
+    alloc_info->backend = NULL; // the file mapping is always done by the os
+    if (!v_alloc_file_open(alloc_info, path, reserve_size, &file_size)) {
+        return false;
+    }
+    alloc_info->flags = (alloc_info->flags & ~(V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G | V_ALLOC_PRECOMMITTED)) | V_ALLOC_FILE;
+    alloc_info->ptr = alloc_info->end = alloc_info->base;
+    if (file_size && !v_alloc_commit_to(alloc_info, file_size)) {
+        v_alloc_file_close(alloc_info, file_size);
+        alloc_info->base = NULL;
+        return false;
+    }
+    alloc_info->ptr = alloc_info->base + file_size;
+    V_STAT(v_alloc_stats_register(alloc_info));
+    return true;
 }
-
-// same as above but param is total size in bytes - mimic behaviour of realloc but user is required to manage AllocInfo
-void* v_alloc_resize(AllocInfo *alloc_info, size_t size_in_bytes) {
-    if(size_in_bytes == 0){ 
-        v_alloc_free(alloc_info);
+#ifdef V_ALLOC_DEBUG
+// the allocation takes whole pages and ends as close to the next page boundary as align allows, the page
+// after it stays uncommitted so any overflow faults. ptr moves past the guard page
+static void *v_alloc_push_guarded(AllocInfo *alloc_info, size_t size, size_t align, bool *full) {
+    size_t page_size = alloc_info->page_size;
+    size_t start = ALIGN_UP((size_t)(alloc_info->ptr - alloc_info->base), page_size);
+    if (start > alloc_info->reserved_size || size > alloc_info->reserved_size - start) {
+        *full = true;
         return NULL;
     }
-    if (size_in_bytes > (size_t)(alloc_info->end - alloc_info->base)) {
-        if(alloc_info->base == 0){ // reserve default
-            if(!v_alloc_reserve(alloc_info, MAX_ARENA_CAPACITY)){
-                return NULL; // unable to reserve memory
-            }
-        }
-        // internally we align_up to page_size
-        size_t adjusted_size_in_bytes = ALIGN_UP(size_in_bytes, alloc_info->page_size);
-
-        if (adjusted_size_in_bytes + alloc_info->base > alloc_info->base + alloc_info->reserved_size) {
-            return NULL; // out of reserved memory
-        }
-        size_t additional_bytes =  adjusted_size_in_bytes - (alloc_info->end - alloc_info->base);
-        int result = v_alloc.commit(alloc_info->base, adjusted_size_in_bytes, additional_bytes);
-        if (result == -1) {
-            return NULL; // failed commit
-        }
-        alloc_info->end = alloc_info->base + adjusted_size_in_bytes;
-        alloc_info->ptr = alloc_info->end;
+    size_t end = start + ALIGN_UP(size, page_size);
+    // aligned as a pointer, base is only page aligned
+    while ((char *)ALIGN_DOWN_PTR(alloc_info->base + end - size, align) < alloc_info->base + start) {
+        end += page_size; // align larger than the slack in the last page
     }
-    return alloc_info->base;
-}
-// embeds AllocInfo at beginning of allocation
-void *v_alloc_realloc(void *data, size_t total_size){
-    AllocHdr *alloc_hdr;
-    if(total_size == 0){
-        if(!data){
-            return NULL;
-        }
-        alloc_hdr = v_alloc_hdr_from_data(data);
-        v_alloc_free(&alloc_hdr->alloc_info);
+    if (end + page_size > alloc_info->reserved_size) {
+        *full = true;
         return NULL;
     }
-    total_size += offsetof(AllocHdr, data);
-    if(!data){
-        AllocInfo alloc_info = {0};
-        if(!v_alloc_resize(&alloc_info, total_size)) {
+    if (end + page_size > (size_t)(v_alloc_load_relaxed(&alloc_info->end) - alloc_info->base)) {
+        if (!v_alloc_commit_locked(alloc_info, end + page_size)) {
             return NULL;
         }
-        alloc_hdr = (AllocHdr*)alloc_info.base;
-        alloc_hdr->alloc_info = alloc_info;
-        return alloc_hdr->data;
     }
-    alloc_hdr = v_alloc_hdr_from_data(data);
-    if(!v_alloc_resize(&alloc_hdr->alloc_info, total_size)) {
-        return NULL;
+    V_STAT(u64 start_ns = v_alloc_stats_now_ns());
+    V_BACKEND(alloc_info)->decommit(alloc_info->base + end, page_size); // the guard page
+    V_STAT(alloc_info->stats.decommit_count++; alloc_info->stats.decommit_ns += v_alloc_stats_now_ns() - start_ns);
+    void *ptr = ALIGN_DOWN_PTR(alloc_info->base + end - size, align);
+    V_STAT(alloc_info->stats.alloc_count++; alloc_info->stats.bytes_requested += size);
+    V_STAT(alloc_info->stats.bytes_padding += end + page_size - (size_t)(alloc_info->ptr - alloc_info->base) - size);
+    v_alloc_store_relaxed(&alloc_info->ptr, alloc_info->base + end + page_size);
+    V_STAT(alloc_info->stats.peak_used = MAX(alloc_info->stats.peak_used, (size_t)(alloc_info->ptr - alloc_info->base)));
+    return ptr;
+}
+#endif
+// V_ALLOC_CHAINED: every block after the first starts with the state of the block before it,
+// AllocInfo always describes the newest block
+typedef struct AllocChainHdr {
+    char *base;
+    char *ptr;
+    char *end;
+    size_t reserved_size;
+    size_t page_size;
+    unsigned flags;
+    void *prev;
+} AllocChainHdr;
+
+#define V_ALLOC_PAGE_FLAGS (V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G | V_ALLOC_PRECOMMITTED)
+
+// reserves a block that fits size at align after its header, twice the size of the current one up to
+// MAX_ARENA_CAPACITY, and makes it the current block
+static bool v_alloc_chain_grow(AllocInfo *alloc_info, size_t size, size_t align) {
+    size_t min_size = sizeof(AllocChainHdr) + align + size;
+#ifdef V_ALLOC_DEBUG
+    min_size += 3 * alloc_info->page_size; // header page, rounding to whole pages and the guard page
+#endif
+    if (min_size < size) {
+        return false; // overflow
     }
-    return alloc_hdr->data;
-}
\ No newline at end of file
+    size_t reserve_size = MAX(MIN(alloc_info->reserved_size * 2, (size_t)MAX_ARENA_CAPACITY), min_size);
+    unsigned flags = alloc_info->flags & (V_ALLOC_HUGE_PAGES | V_ALLOC_HUGE_1G);
+    size_t page_size;
+    char *base;
+    if (alloc_info->flags & V_ALLOC_NUMA) {
+        base = v_alloc_node_reserve(reserve_size, alloc_info->numa_node, &flags, &page_size);
+    } else {
+        base = (char *)V_BACKEND(alloc_info)->reserve(reserve_size, &flags, &page_size);
+    }
+    if (!base) {
+        return false;
+    }
+    unsigned fork_policy = alloc_info->flags & (V_ALLOC_FORK_WIPE | V_ALLOC_FORK_SKIP);
+    if (fork_policy && !v_alloc_fork_advise(base, reserve_size, fork_policy)) {
+        V_BACKEND(alloc_info)->release(base, reserve_size);
+        return false;
+    }
+    AllocChainHdr hdr = {
+        alloc_info->base, alloc_info->ptr, alloc_info->end, alloc_info->reserved_size,
+        alloc_info->page_size, alloc_info->flags & V_ALLOC_PAGE_FLAGS, alloc_info->chain
+    };
+    v_atomic_lock(&alloc_info->commit_lock);
+    alloc_info->base = alloc_info->ptr = base;
+    alloc_info->end = (flags & V_ALLOC_PRECOMMITTED) ? base + ALIGN_UP(reserve_size, page_size) : base;
+    alloc_info->reserved_size = ALIGN_UP(reserve_size, page_size);
+    alloc_info->page_size = page_size;
+    alloc_info->flags = (alloc_info->flags & ~V_ALLOC_PAGE_FLAGS) | flags;
+    bool result = alloc_info->end != base || v_alloc_commit_to(alloc_info, sizeof(AllocChainHdr));
+    if (result) {
+        *(AllocChainHdr *)base = hdr;
+        alloc_info->chain = base;
+        alloc_info->ptr = base + sizeof(AllocChainHdr);
+    } else { // back to the old block
+        alloc_info->base = hdr.base;
+        alloc_info->ptr = hdr.ptr;
+        alloc_info->end = hdr.end;
+        alloc_info->reserved_size = hdr.reserved_size;
+        alloc_info->page_size = hdr.page_size;
+        alloc_info->flags = (alloc_info->flags & ~V_ALLOC_PAGE_FLAGS) | hdr.flags;
+        V_BACKEND(alloc_info)->release(base, reserve_size);
+    }
+    v_atomic_unlock(&alloc_info->commit_lock);
+    return result;
+}
+// releases blocks newest first until base is the current block, NULL stops at the first block
+static void v_alloc_chain_pop(AllocInfo *alloc_info, char *base) {
+    v_atomic_lock(&alloc_info->commit_lock);
+    while (alloc_info->chain && alloc_info->base != base) {
+        AllocChainHdr hdr = *(AllocChainHdr *)alloc_info->chain;
+        V_BACKEND(alloc_info)->release(alloc_info->base, alloc_info->reserved_size);
+        alloc_info->base = hdr.base;
+        alloc_info->ptr = hdr.ptr;
+        alloc_info->end = hdr.end;
+        alloc_info->reserved_size = hdr.reserved_size;
+        alloc_info->page_size = hdr.page_size;
+        alloc_info->flags = (alloc_info->flags & ~V_ALLOC_PAGE_FLAGS) | hdr.flags;
+        alloc_info->chain = hdr.prev;
+    }
+    v_atomic_unlock(&alloc_info->commit_lock);
+}
+static bool v_alloc_chain_contains(AllocInfo *alloc_info, char *base) {
+    if (alloc_info->base == base) {
+        return true;
+    }
+    for (AllocChainHdr *hdr = alloc_info->chain; hdr; hdr = hdr->prev) {
+        if (hdr->base == base) {
+            return true;
+        }
+    }
+    return false;
+}
+// pushes into the current block. full is set when the request doesn't fit into the reservation at all,
+// as opposed to a commit that failed
+static void *v_alloc_push_block(AllocInfo *alloc_info, size_t size, size_t align, bool *full) {
+    *full = false;
+#ifdef V_ALLOC_DEBUG
+    if (!(alloc_info->flags & V_ALLOC_FILE)) {
+        return v_alloc_push_guarded(alloc_info, size, align, full);
+    }
+#endif
+    // the pointer is aligned, not the offset: base is only page aligned
+    size_t offset = (char *)ALIGN_UP_PTR(alloc_info->ptr, align) - alloc_info->base;
+    if (offset > alloc_info->reserved_size || size > alloc_info->reserved_size - offset) {
+        *full = true;
+        return NULL; // doesn't fit into the reservation
+    }
+    if (offset + size > (size_t)(v_alloc_load_relaxed(&alloc_info->end) - alloc_info->base)) {
+        if (!v_alloc_commit_locked(alloc_info, offset + size)) {
+            return NULL;
+        }
+    }
+    V_STAT(alloc_info->stats.alloc_count++; alloc_info->stats.bytes_requested += size);
+    V_STAT(alloc_info->stats.bytes_padding += offset - (size_t)(alloc_info->ptr - alloc_info->base));
+    void* ptr = alloc_info->base + offset;
+    v_alloc_store_relaxed(&alloc_info->ptr, alloc_info->base + offset + size);
+    V_STAT(alloc_info->stats.peak_used = MAX(alloc_info->stats.peak_used, (size_t)(alloc_info->ptr - alloc_info->base)));
+    return ptr; 
+}
+// out of line part of v_alloc_push_aligned and v_alloc_committ: reserves the default capacity on first use
+// and commits more pages when the request crosses end. returns NULL on fail
+V_COLD void* v_alloc_push_aligned_slow(AllocInfo *alloc_info, size_t size, size_t align) {
+    if (size == 0 || align == 0 || (align & (align - 1))) { // we will consider this an error
+        return NULL;
+    }
+    bool chained = (alloc_info->flags & V_ALLOC_CHAINED) && !(alloc_info->flags & V_ALLOC_FILE);
+    if (alloc_info->base == 0) { // reserve default, chained arenas start small and grow by blocks
+        if (!v_alloc_reserve(alloc_info, chained ? V_ALLOC_CHAIN_BLOCK : MAX_ARENA_CAPACITY)) {
+            return NULL; // unable to reserve memory
+        }
+    }
+    bool full;
+    void *ptr = v_alloc_push_block(alloc_info, size, align, &full);
+    // only a reservation that is used up gets a new block, a failed commit stays a failure
+    if (!ptr && full && chained && v_alloc_chain_grow(alloc_info, size, align)) {
+        ptr = v_alloc_push_block(alloc_info, size, align, &full);
+    }
+    return ptr;
+}
+// lays out count blocks of sizes[i] * scale bytes, each at align, as one push. on fail nothing is allocated
+static bool v_alloc_batch(AllocInfo *alloc_info, const size_t *sizes, size_t scale, void **out, size_t count, size_t align) {
+    if (align == 0 || (align & (align - 1))) {
+        return false;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (scale && sizes[i] > SIZE_MAX / scale) {
+            return false; // overflow
+        }
+        size_t size = ALIGN_UP(sizes[i] * scale, align);
+        if (size < sizes[i] * scale || total + size < total) {
+            return false;
+        }
+        total += size;
+    }
+    // an empty batch allocates nothing, every pointer is the current position
+    char *ptr = total ? v_alloc_push_aligned(alloc_info, total, align) : alloc_info->ptr;
+    if (!ptr && total) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        out[i] = ptr;
+        ptr += ALIGN_UP(sizes[i] * scale, align);
+    }
+    return true;
+}
+// one bounds check and at most one commit for count allocations, out[i] gets sizes[i] bytes at V_ALLOC_ALIGNMENT
+bool v_alloc_committ_batch(AllocInfo *alloc_info, const size_t *sizes, void **out, size_t count) {
+    return v_alloc_batch(alloc_info, sizes, 1, out, count, V_ALLOC_ALIGNMENT);
+}
+bool v_alloc_committ_batch_aligned(AllocInfo *alloc_info, const size_t *sizes, void **out, size_t count, size_t align) {
+    return v_alloc_batch(alloc_info, sizes, 1, out, count, align);
+}
+// struct of arrays: columns[i] gets rows elements of elem_sizes[i] bytes, every column starts at
+// V_ALLOC_SOA_ALIGNMENT and all of them share one contiguous block
+bool v_alloc_soa(AllocInfo *alloc_info, size_t rows, const size_t *elem_sizes, void **columns, size_t column_count) {
+    return v_alloc_batch(alloc_info, elem_sizes, rows, columns, column_count, V_ALLOC_SOA_ALIGNMENT);
+}
+// thread safe variant of v_alloc_committ for an arena shared by many threads. space is claimed with an
+// atomic add on ptr, only the threads that cross end take the commit lock. the arena must be reserved up
+// front and reset only while no thread allocates from it. don't mix with v_alloc_committ on the same arena
+void *v_alloc_committ_shared(AllocInfo *alloc_info, size_t additional_bytes) {
+    if (additional_bytes == 0 || alloc_info->base == NULL) {
+        return NULL;
+    }
+    V_STAT(v_atomic_add_size(&alloc_info->stats.alloc_count, 1));
+    V_STAT(v_atomic_add_size(&alloc_info->stats.bytes_requested, additional_bytes));
+    V_STAT(v_atomic_add_size(&alloc_info->stats.bytes_padding, ALIGN_UP(additional_bytes, V_ALLOC_ALIGNMENT) - additional_bytes));
+    additional_bytes = ALIGN_UP(additional_bytes, V_ALLOC_ALIGNMENT); // keeps every claimed ptr aligned
+    char *ptr = v_atomic_fetch_add_ptr(&alloc_info->ptr, additional_bytes);
+    size_t needed_size = ptr - alloc_info->base + additional_bytes;
+    if (needed_size > (size_t)(v_atomic_load_ptr(&alloc_info->end) - alloc_info->base)) {
+        if (needed_size > alloc_info->reserved_size) {
+            return NULL; // out of reserved memory, ptr stays past the end so later calls fail too
+        }
+        if (!v_alloc_commit_locked(alloc_info, needed_size)) {
+            return NULL;
+        }
+    }
+    V_STAT(v_atomic_max_size(&alloc_info->stats.peak_used, needed_size));
+    return ptr;
+}
+// every commit grows the arena by at least commit_chunk bytes. with a nonzero commit_max the step
+// instead doubles along with the committed size, capped at commit_max. zeroes commit page by page
+void v_alloc_set_commit_policy(AllocInfo *alloc_info, size_t commit_chunk, size_t commit_max) {
+    alloc_info->commit_chunk = commit_chunk;
+    alloc_info->commit_max = commit_max;
+}
+// with a retain policy set, decommits whatever is committed beyond max(ptr, retain_size, high_water)
+static void v_alloc_trim(AllocInfo *alloc_info) {
+#ifdef V_ALLOC_DEBUG // everything rolled back is decommitted so stale pointers fault
+    if (alloc_info->flags & (V_ALLOC_PRECOMMITTED | V_ALLOC_FILE)) {
+        return;
+    }
+    size_t keep = alloc_info->ptr - alloc_info->base;
+#else
+    if (alloc_info->retain_size == 0 || (alloc_info->flags & (V_ALLOC_PRECOMMITTED | V_ALLOC_FILE))) {
+        return; // keep everything, large pages and file views can't be decommitted
+    }
+    size_t keep = MAX((size_t)(alloc_info->ptr - alloc_info->base), alloc_info->retain_size);
+    keep = MAX(keep, alloc_info->high_water);
+#endif
+    keep = ALIGN_UP(keep, alloc_info->page_size);
+    size_t committed = v_alloc_load_relaxed(&alloc_info->end) - alloc_info->base; // the committer may move it
+    if (committed > keep) {
+        v_alloc_decommit(alloc_info, committed - keep);
+    }
+}
+// pop/reset keep at least retain_size bytes (plus the decaying high water mark) committed and give
+// the rest back, 0 keeps everything committed
+void v_alloc_set_retain(AllocInfo *alloc_info, size_t retain_size) {
+    alloc_info->retain_size = retain_size;
+}
+// what a forked child gets of the arena: 0 copies it on write (the default), V_ALLOC_FORK_WIPE hands the
+// child zero pages and V_ALLOC_FORK_SKIP leaves the range out entirely. skipping the big reservations
+// keeps fork from duplicating their page tables. blocks chained in later inherit the policy
+bool v_alloc_set_fork_policy(AllocInfo *alloc_info, unsigned policy) {
+    unsigned fork_flags = V_ALLOC_FORK_WIPE | V_ALLOC_FORK_SKIP;
+    if (!alloc_info->base || (policy & ~fork_flags) || policy == fork_flags) {
+        return false;
+    }
+    if (alloc_info->flags & V_ALLOC_FILE) {
+        return false; // a child's commits and free would resize the parent's file
+    }
+    if (!v_alloc_fork_advise(alloc_info->base, alloc_info->reserved_size, policy)) {
+        return false;
+    }
+    alloc_info->flags = (alloc_info->flags & ~fork_flags) | policy;
+    return true;
+}
+// freezes the committed pages of a warmed up arena before forking, so neither side can write them and the
+// copy on write pages stay shared. pushes that land in the frozen range fault, pages committed later are writable
+bool v_alloc_set_read_only(AllocInfo *alloc_info, bool read_only) {
+    size_t committed = alloc_info->end - alloc_info->base;
+    return committed == 0 || v_alloc_protect(alloc_info->base, committed, read_only);
+}
+// call in the child for every arena with a fork policy. a wiped arena starts over empty in its zeroed
+// range, a skipped one gets a fresh reservation of the same size. older chained blocks are left behind
+void v_alloc_fork_child(AllocInfo *alloc_info) {
+    if (alloc_info->flags & V_ALLOC_FORK_WIPE) {
+        alloc_info->ptr = alloc_info->base;
+        alloc_info->chain = NULL; // the header of the current block was wiped with the rest
+        alloc_info->high_water = 0;
+    } else if (alloc_info->flags & V_ALLOC_FORK_SKIP) {
+        V_STAT(v_alloc_stats_unregister(alloc_info));
+        size_t reserved_size = alloc_info->reserved_size;
+        unsigned flags = alloc_info->flags & ~(V_ALLOC_PRECOMMITTED | V_ALLOC_WATCHED | V_ALLOC_NUMA);
+        alloc_info->base = alloc_info->ptr = alloc_info->end = NULL;
+        alloc_info->chain = NULL;
+        alloc_info->high_water = 0;
+        bool reserved;
+        if (alloc_info->flags & V_ALLOC_NUMA) { // the new range is bound to the same node again
+            alloc_info->flags = flags;
+            reserved = v_alloc_reserve_node(alloc_info, reserved_size, alloc_info->numa_node);
+        } else {
+            reserved = v_alloc_reserve_ex(alloc_info, reserved_size, flags);
+        }
+        if (reserved) {
+            v_alloc_set_fork_policy(alloc_info, flags & V_ALLOC_FORK_SKIP);
+        }
+    }
+}
+AllocMark v_alloc_mark(AllocInfo *alloc_info) {
+    AllocMark mark = { alloc_info->base, alloc_info->ptr };
+    return mark;
+}
+// rolls back every allocation made since the mark was taken
+void v_alloc_pop_to(AllocInfo *alloc_info, AllocMark mark) {
+    if (mark.base == NULL) { // taken before the arena reserved anything
+        v_alloc_chain_pop(alloc_info, NULL);
+        mark.base = mark.ptr = alloc_info->base;
+    }
+    if (alloc_info->chain && v_alloc_chain_contains(alloc_info, mark.base)) {
+        v_alloc_chain_pop(alloc_info, mark.base); // blocks linked in after the mark go away entirely
+    }
+    if (mark.base != alloc_info->base || mark.ptr > alloc_info->ptr) {
+        return; // not from this arena or already popped past it
+    }
+    v_alloc_store_relaxed(&alloc_info->ptr, mark.ptr);
+    v_alloc_trim(alloc_info);
+}
+void v_alloc_reset(AllocInfo *alloc_info) {
+    // reset the pointer to the start of the committed region
+    if(alloc_info){
+        // the high water mark decays by a quarter per reset, so a single burst is released over a few
+        // cycles while a steady peak stays committed and regrowing doesn't fault the pages back in
+        v_alloc_chain_pop(alloc_info, NULL); // only the first block is kept
+        size_t used = alloc_info->ptr - alloc_info->base;
+        alloc_info->high_water = MAX(used, alloc_info->high_water - alloc_info->high_water / 4);
+        v_alloc_store_relaxed(&alloc_info->ptr, alloc_info->base);
+        V_STAT(alloc_info->stats.reset_count++; alloc_info->stats.reset_used = used);
+        v_alloc_trim(alloc_info);
+    }
+}
+bool v_alloc_decommit(AllocInfo *alloc_info, size_t extra_size) {
+    if (!alloc_info || extra_size == 0) {
+        return false; // invalid input
+    }
+    // ensure extra_size is aligned to the page size
+    extra_size = ALIGN_UP(extra_size, alloc_info->page_size);
+    v_atomic_lock(&alloc_info->commit_lock);
+    // ensure extra_size does not exceed the committed memory size
+    if (extra_size > (size_t)(alloc_info->end - alloc_info->base)) {
+        v_atomic_unlock(&alloc_info->commit_lock);
+        return false; // cannot decommit more memory than is committed
+    }
+    // ensure the decommit region is page-aligned
+    char *decommit_start = ALIGN_DOWN_PTR(alloc_info->end - extra_size, alloc_info->page_size);
+    // decommit the memory
+    V_STAT(u64 start_ns = v_alloc_stats_now_ns());
+    bool result = V_BACKEND(alloc_info)->decommit(decommit_start, extra_size);
+    V_STAT(alloc_info->stats.decommit_count++; alloc_info->stats.decommit_ns += v_alloc_stats_now_ns() - start_ns);
+    if (result) {
+        v_atomic_store_ptr(&alloc_info->end, decommit_start);
+    }
+    v_atomic_unlock(&alloc_info->commit_lock);
+    return result;
+}
+bool v_alloc_free(AllocInfo* alloc_info) {
+    if (alloc_info->base == NULL) {
+        return false; // nothing to free
+    }
+    if (alloc_info->flags & V_ALLOC_WATCHED) {
+        v_alloc_committer_remove(alloc_info);
+    }
+    v_alloc_chain_pop(alloc_info, NULL);
+    V_STAT(v_alloc_stats_unregister(alloc_info));
+    if (alloc_info->flags & V_ALLOC_FILE) { // the file keeps exactly the bytes in use
+        return v_alloc_file_close(alloc_info, alloc_info->ptr - alloc_info->base);
+    }
+    return V_BACKEND(alloc_info)->release(alloc_info->base, alloc_info->reserved_size);
+}
+
+
+typedef struct AllocHdr {  
+    AllocInfo alloc_info; 
+    _Alignas(V_ALLOC_ALIGNMENT) char data[];
+} AllocHdr;
+
+static inline AllocHdr *v_alloc_hdr_from_data(void *data) { 
+    return (AllocHdr*)((char*)(data) - offsetof(AllocHdr, data)); 
+}
+
+// same as above but param is total size in bytes - mimic behaviour of realloc but user is required to manage AllocInfo.
+// shrinking keeps the pointer and decommits the tail pages
+void* v_alloc_resize(AllocInfo *alloc_info, size_t size_in_bytes) {
+    if(size_in_bytes == 0){ 
+        v_alloc_free(alloc_info);
+        return NULL;
+    }
+    if (size_in_bytes > (size_t)(alloc_info->end - alloc_info->base)) {
+        if(alloc_info->base == 0){ // reserve default
+            if(!v_alloc_reserve(alloc_info, MAX_ARENA_CAPACITY)){
+                return NULL; // unable to reserve memory
+            }
+        }
+        if (!v_alloc_commit_locked(alloc_info, size_in_bytes)) {
+            return NULL;
+        }
+        alloc_info->ptr = alloc_info->end;
+    } else if (!(alloc_info->flags & (V_ALLOC_PRECOMMITTED | V_ALLOC_FILE))) {
+        // shrinks below a quarter of what's committed give back all but twice the new size, so sizes
+        // bouncing around the threshold don't decommit and refault the same pages
+        size_t committed = alloc_info->end - alloc_info->base;
+        size_t keep = ALIGN_UP(size_in_bytes * 2, alloc_info->page_size);
+        if (size_in_bytes < committed / 4 && keep < committed && v_alloc_decommit(alloc_info, committed - keep)) {
+            alloc_info->ptr = MIN(alloc_info->ptr, alloc_info->end);
+        }
+    }
+    return alloc_info->base;
+}
+// embeds AllocInfo at beginning of allocation
+void *v_alloc_realloc(void *data, size_t total_size){
+    AllocHdr *alloc_hdr;
+    if(total_size == 0){
+        if(!data){
+            return NULL;
+        }
+        alloc_hdr = v_alloc_hdr_from_data(data);
+        v_alloc_free(&alloc_hdr->alloc_info);
+        return NULL;
+    }
+    if(!data){
+        AllocInfo alloc_info = {0};
+        size_t block_size = total_size + offsetof(AllocHdr, data);
+        if (block_size < total_size) {
+            return NULL; // overflow
+        }
+        if(!v_alloc_resize(&alloc_info, block_size)) {
+            if (alloc_info.base) { // reserved but the commit failed, unlinks it from the stats registry too
+                v_alloc_free(&alloc_info);
+            }
+            return NULL;
+        }
+        alloc_hdr = (AllocHdr*)alloc_info.base;
+        alloc_hdr->alloc_info = alloc_info;
+        V_STAT(v_alloc_stats_move(&alloc_info, &alloc_hdr->alloc_info));
+        return alloc_hdr->data;
+    }
+    alloc_hdr = v_alloc_hdr_from_data(data);
+    // the header sits at base unless the block was placed for alignment (v_malloc_aligned)
+    total_size += (char *)data - alloc_hdr->alloc_info.base;
+    if(!v_alloc_resize(&alloc_hdr->alloc_info, total_size)) {
+        return NULL;
+    }
+    return alloc_hdr->data;
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: committer
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// background thread that commits ahead of ptr for registered arenas, so the allocating
+// thread rarely leaves the fast path. prefaults too when the arena has V_ALLOC_PREFAULT
+#if defined(_WIN32)
+    typedef HANDLE VThread;
+#else
+    #include <pthread.h>
+    #include <time.h>
+    typedef pthread_t VThread;
+#endif
+
+typedef struct VCommitterEntry {
+    AllocInfo *alloc_info;
+    size_t low_water; // commit once end - ptr drops below this
+    size_t chunk;     // bytes committed past end each time
+} VCommitterEntry;
+
+static struct {
+    VCommitterEntry entries[V_ALLOC_COMMITTER_MAX];
+    size_t count;
+    long lock;    // guards entries, held for a whole scan so remove waits for in flight commits
+    long running;
+    unsigned interval_us;
+    VThread thread;
+} v_committer;
+
+static void v_committer_scan(void) {
+    v_atomic_lock(&v_committer.lock);
+    for (size_t i = 0; i < v_committer.count; i++) {
+        VCommitterEntry *entry = &v_committer.entries[i];
+        AllocInfo *alloc_info = entry->alloc_info;
+        char *ptr = v_atomic_load_ptr(&alloc_info->ptr);
+        char *end = v_atomic_load_ptr(&alloc_info->end);
+        if (end - ptr >= (ptrdiff_t)entry->low_water) {
+            continue;
+        }
+        size_t reserved_size = ALIGN_DOWN(alloc_info->reserved_size, alloc_info->page_size);
+        size_t needed_size = MIN((size_t)(end - alloc_info->base) + entry->chunk, reserved_size);
+        v_alloc_commit_locked(alloc_info, needed_size);
+    }
+    v_atomic_unlock(&v_committer.lock);
+}
+#if defined(_WIN32)
+    static DWORD WINAPI v_committer_main(LPVOID arg) {
+        (void)arg;
+        while (v_atomic_load_long(&v_committer.running)) {
+            v_committer_scan();
+            Sleep(MAX(v_committer.interval_us / 1000, 1));
+        }
+        return 0;
+    }
+    static bool v_committer_thread_start(void) {
+        v_committer.thread = CreateThread(NULL, 0, v_committer_main, NULL, 0, NULL);
+        return v_committer.thread != NULL;
+    }
+    static void v_committer_thread_join(void) {
+        WaitForSingleObject(v_committer.thread, INFINITE);
+        CloseHandle(v_committer.thread);
+    }
+#else
+    static void *v_committer_main(void *arg) {
+        (void)arg;
+        while (v_atomic_load_long(&v_committer.running)) {
+            v_committer_scan();
+            struct timespec interval = { v_committer.interval_us / 1000000, (v_committer.interval_us % 1000000) * 1000 };
+            nanosleep(&interval, NULL);
+        }
+        return NULL;
+    }
+    static bool v_committer_thread_start(void) {
+        return pthread_create(&v_committer.thread, NULL, v_committer_main, NULL) == 0;
+    }
+    static void v_committer_thread_join(void) {
+        pthread_join(v_committer.thread, NULL);
+    }
+#endif
+// starts the committer thread, it wakes up every interval_us to check the registered arenas
+bool v_alloc_committer_start(unsigned interval_us) {
+    if (v_atomic_load_long(&v_committer.running)) {
+        return true;
+    }
+    v_committer.interval_us = interval_us ? interval_us : 100;
+    v_atomic_store_long(&v_committer.running, 1);
+    if (!v_committer_thread_start()) {
+        v_atomic_store_long(&v_committer.running, 0);
+        return false;
+    }
+    return true;
+}
+// stops and joins the committer thread, registered arenas stay registered
+void v_alloc_committer_stop(void) {
+    if (v_atomic_load_long(&v_committer.running)) {
+        v_atomic_store_long(&v_committer.running, 0);
+        v_committer_thread_join();
+    }
+}
+// the arena must be reserved. once end - ptr drops below low_water the committer commits chunk more bytes
+bool v_alloc_committer_add(AllocInfo *alloc_info, size_t low_water, size_t chunk) {
+    if (!alloc_info->base || chunk == 0 || (alloc_info->flags & V_ALLOC_CHAINED)) {
+        return false; // the committer doesn't follow the switch to a new block
+    }
+    v_atomic_lock(&v_committer.lock);
+    bool result = v_committer.count < V_ALLOC_COMMITTER_MAX && !(alloc_info->flags & V_ALLOC_WATCHED);
+    if (result) {
+        v_committer.entries[v_committer.count++] = (VCommitterEntry){ alloc_info, low_water, chunk };
+        alloc_info->flags |= V_ALLOC_WATCHED;
+    }
+    v_atomic_unlock(&v_committer.lock);
+    return result;
+}
+// v_alloc_free removes the arena on its own
+void v_alloc_committer_remove(AllocInfo *alloc_info) {
+    v_atomic_lock(&v_committer.lock);
+    for (size_t i = 0; i < v_committer.count; i++) {
+        if (v_committer.entries[i].alloc_info == alloc_info) {
+            v_committer.entries[i] = v_committer.entries[--v_committer.count];
+            alloc_info->flags &= ~V_ALLOC_WATCHED;
+            break;
+        }
+    }
+    v_atomic_unlock(&v_committer.lock);
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: array
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// capacity is whatever fits in the committed pages, commits grow geometrically up to V_ARRAY_COMMIT_MAX
+bool v_array_grow(void **array, size_t min_cap, size_t elem_size) {
+    VArrayHdr *hdr = *array ? v_array_hdr(*array) : NULL;
+    if (hdr && hdr->cap >= min_cap) {
+        return true;
+    }
+    if (min_cap > (SIZE_MAX - offsetof(VArrayHdr, data)) / elem_size) {
+        return false; // overflow
+    }
+    VArrayHdr *new_hdr = v_alloc_realloc(hdr, offsetof(VArrayHdr, data) + min_cap * elem_size);
+    if (!new_hdr) {
+        return false;
+    }
+    AllocHdr *alloc_hdr = v_alloc_hdr_from_data(new_hdr);
+    if (!hdr) {
+        new_hdr->len = 0;
+        v_alloc_set_commit_policy(&alloc_hdr->alloc_info, 0, V_ARRAY_COMMIT_MAX);
+    }
+    new_hdr->cap = (alloc_hdr->alloc_info.end - new_hdr->data) / elem_size;
+    *array = new_hdr->data;
+    return true;
+}
+// opens count empty elements at index, shifting the tail up
+bool v_array_make_gap(void **array, size_t index, size_t count, size_t elem_size) {
+    size_t len = *array ? v_array_hdr(*array)->len : 0;
+    if (index > len || !v_array_grow(array, len + count, elem_size)) {
+        return false;
+    }
+    char *data = *array;
+    memmove(data + (index + count) * elem_size, data + index * elem_size, (len - index) * elem_size);
+    v_array_hdr(*array)->len = len + count;
+    return true;
+}
+void v_array_release(void *array) {
+    if (array) {
+        v_alloc_realloc(v_array_hdr(array), 0);
+    }
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: numa
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+unsigned v_alloc_numa_node_count(void) {
+    return v_alloc_node_count();
+}
+// node of the cpu the calling thread runs on right now, threads can migrate
+unsigned v_alloc_numa_current_node(void) {
+    return v_alloc_current_node();
+}
+// reserves reserve_size per node, nodes past V_ALLOC_NUMA_MAX are folded onto the first ones
+bool v_alloc_numa_init(AllocNumaArenas *arenas, size_t reserve_size) {
+    *arenas = (AllocNumaArenas){0};
+    unsigned count = MIN(v_alloc_node_count(), V_ALLOC_NUMA_MAX);
+    for (unsigned node = 0; node < count; node++) {
+        if (!v_alloc_reserve_node(&arenas->nodes[node], reserve_size, node)) {
+            v_alloc_numa_release(arenas);
+            return false;
+        }
+        arenas->node_count = node + 1;
+    }
+    return true;
+}
+// arena of the calling thread's current node. it's shared by every thread on that node, allocate from it
+// with v_alloc_committ_shared. looks up the cpu each call, hold on to the result in hot loops
+AllocInfo *v_alloc_numa_arena(AllocNumaArenas *arenas) {
+    return &arenas->nodes[v_alloc_current_node() % arenas->node_count];
+}
+void v_alloc_numa_release(AllocNumaArenas *arenas) {
+    for (unsigned node = 0; node < arenas->node_count; node++) {
+        v_alloc_free(&arenas->nodes[node]);
+    }
+    *arenas = (AllocNumaArenas){0};
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: handles
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// the slots are one v_alloc_resize range rather than a VPool, so index * elem_size holds in V_ALLOC_DEBUG
+// too. max_count 0 reserves room for V_HANDLE_MAX_COUNT slots. free slots hold the index of the next one
+bool v_handle_pool_init(VHandlePool *pool, size_t elem_size, uint32_t max_count) {
+    *pool = (VHandlePool){0};
+    if (elem_size == 0 || max_count > V_HANDLE_MAX_COUNT) {
+        return false;
+    }
+    pool->max_count = max_count = max_count ? max_count : V_HANDLE_MAX_COUNT;
+    pool->elem_size = ALIGN_UP(MAX(elem_size, sizeof(u32)), V_ALLOC_ALIGNMENT);
+    if (!v_alloc_reserve(&pool->slots, pool->elem_size * max_count) ||
+        !v_alloc_reserve(&pool->generations, max_count)) {
+        v_handle_pool_release(pool);
+        return false;
+    }
+    v_alloc_set_commit_policy(&pool->slots, 64 * 1024, 64 * 1024 * 1024);
+    v_alloc_set_commit_policy(&pool->generations, 64 * 1024, 0);
+    return true;
+}
+// returns 0 when the pool is full
+VHandle v_handle_alloc(VHandlePool *pool) {
+    u32 index;
+    if (pool->free_head) {
+        index = pool->free_head - 1;
+        pool->free_head = *(u32 *)(pool->slots.base + (size_t)index * pool->elem_size);
+    } else {
+        index = pool->count;
+        if (index == pool->capacity) {
+            // grow only, resizing down would decommit generations and make stale handles valid again
+            u32 capacity = index == pool->max_count ? 0 : (u32)MIN((size_t)pool->max_count, MAX((size_t)index * 2, 64));
+            if (!capacity ||
+                !v_alloc_resize(&pool->slots, (size_t)capacity * pool->elem_size) ||
+                !v_alloc_resize(&pool->generations, capacity)) {
+                return 0;
+            }
+            pool->capacity = capacity;
+        }
+        pool->count++;
+    }
+    u8 *generation = (u8 *)pool->generations.base + index;
+    if (*generation == 0) { // fresh pages, generation 0 is what makes handle 0 invalid
+        *generation = 1;
+    }
+    return ((VHandle)*generation << V_HANDLE_INDEX_BITS) | index;
+}
+static void v_handle_bump(u8 *generation) {
+    *generation = *generation == 0xff ? 1 : *generation + 1;
+}
+// stale handles are ignored
+void v_handle_free(VHandlePool *pool, VHandle handle) {
+    char *slot = v_handle_get(pool, handle);
+    if (!slot) {
+        return;
+    }
+    u32 index = handle & (V_HANDLE_MAX_COUNT - 1);
+    v_handle_bump((u8 *)pool->generations.base + index);
+    V_POISON_SLOT(slot, pool->elem_size);
+    *(u32 *)slot = pool->free_head;
+    pool->free_head = index + 1;
+}
+// frees every slot at once, each handle handed out before turns stale. slots and generations stay
+// committed up to capacity, the bumped generations are what keeps the old handles invalid
+void v_handle_pool_reset(VHandlePool *pool) {
+    for (u32 index = 0; index < pool->count; index++) {
+        v_handle_bump((u8 *)pool->generations.base + index);
+    }
+    pool->count = 0;
+    pool->free_head = 0;
+}
+void v_handle_pool_release(VHandlePool *pool) {
+    if (pool->slots.base) {
+        v_alloc_free(&pool->slots);
+    }
+    if (pool->generations.base) {
+        v_alloc_free(&pool->generations);
+    }
+    *pool = (VHandlePool){0};
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: ring
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// size is rounded up to the page size (64 KiB allocation granularity on windows)
+bool v_ring_init(VRing *ring, size_t size) {
+    *ring = (VRing){0};
+    if (size == 0) {
+        return false;
+    }
+    size = ALIGN_UP(size, v_alloc_ring_granularity());
+    ring->base = v_alloc_ring_map(size, &ring->handle);
+    if (!ring->base) {
+        return false;
+    }
+    ring->size = size;
+    return true;
+}
+void v_ring_release(VRing *ring) {
+    if (ring->base) {
+        v_alloc_ring_unmap(ring->base, ring->size, ring->handle);
+    }
+    *ring = (VRing){0};
+}
+char *v_ring_write_ptr(VRing *ring, size_t *available) {
+    *available = ring->size - (ring->head - ring->tail);
+    return ring->base + ring->head % ring->size;
+}
+void v_ring_produce(VRing *ring, size_t bytes) {
+    ring->head += bytes;
+}
+char *v_ring_read_ptr(VRing *ring, size_t *available) {
+    *available = ring->head - ring->tail;
+    return ring->base + ring->tail % ring->size;
+}
+void v_ring_consume(VRing *ring, size_t bytes) {
+    ring->tail += bytes;
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: frame
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// frame_count 2 keeps the previous frame alive, 3 the two before it. each arena reserves reserve_size
+// (0 for MAX_ARENA_CAPACITY) and keeps retain_size committed across resets, see v_alloc_set_retain
+bool v_alloc_frame_init(VFrameArena *frames, unsigned frame_count, size_t reserve_size, size_t retain_size) {
+    *frames = (VFrameArena){0};
+    if (frame_count < 2 || frame_count > V_ALLOC_FRAME_MAX) {
+        return false;
+    }
+    for (unsigned i = 0; i < frame_count; i++) {
+        if (!v_alloc_reserve(&frames->frames[i], reserve_size ? reserve_size : MAX_ARENA_CAPACITY)) {
+            v_alloc_frame_release(frames);
+            return false;
+        }
+        v_alloc_set_retain(&frames->frames[i], retain_size);
+        frames->frame_count = i + 1;
+    }
+    return true;
+}
+// starts the next frame in the oldest arena and returns it, everything allocated in that arena frame_count
+// frames ago is gone. last_used is the frame that just ended, so sizing off it reacts to the latest frame
+AllocInfo *v_alloc_frame_advance(VFrameArena *frames) {
+    AllocInfo *ended = &frames->frames[frames->current];
+    frames->last_used = ended->ptr - ended->base;
+    frames->current = (frames->current + 1) % frames->frame_count;
+    AllocInfo *frame = &frames->frames[frames->current];
+    v_alloc_reset(frame);
+    return frame;
+}
+void v_alloc_frame_release(VFrameArena *frames) {
+    for (unsigned i = 0; i < frames->frame_count; i++) {
+        v_alloc_free(&frames->frames[i]);
+    }
+    *frames = (VFrameArena){0};
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: scratch
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// two arenas per thread: when a function gets a scratch arena from its caller (to allocate its results in)
+// it passes it as the conflict and gets the other one, so nested scopes never stomp each other
+static V_THREAD_LOCAL AllocInfo v_alloc_scratch[2];
+
+// the arenas of a thread are released when it exits, otherwise its reservations would leak and with
+// V_ALLOC_STATS the registry would point into the thread's freed storage
+#if defined(_WIN32)
+    static DWORD v_alloc_scratch_key = FLS_OUT_OF_INDEXES;
+    static long v_alloc_scratch_key_lock;
+    static VOID WINAPI v_alloc_scratch_exit(PVOID arg) {
+        (void)arg;
+        v_alloc_scratch_release();
+    }
+    static void v_alloc_scratch_hook(void) {
+        if (v_atomic_load_long((long *)&v_alloc_scratch_key) == (long)FLS_OUT_OF_INDEXES) {
+            v_atomic_lock(&v_alloc_scratch_key_lock);
+            if (v_alloc_scratch_key == FLS_OUT_OF_INDEXES) {
+                v_atomic_store_long((long *)&v_alloc_scratch_key, (long)FlsAlloc(v_alloc_scratch_exit));
+            }
+            v_atomic_unlock(&v_alloc_scratch_key_lock);
+        }
+        if (v_alloc_scratch_key != FLS_OUT_OF_INDEXES) {
+            FlsSetValue(v_alloc_scratch_key, v_alloc_scratch); // the callback only runs for non NULL values
+        }
+    }
+#else
+    static pthread_key_t v_alloc_scratch_key;
+    static pthread_once_t v_alloc_scratch_once = PTHREAD_ONCE_INIT;
+    static bool v_alloc_scratch_key_ok;
+    static void v_alloc_scratch_exit(void *arg) {
+        (void)arg;
+        v_alloc_scratch_release();
+    }
+    static void v_alloc_scratch_key_init(void) {
+        v_alloc_scratch_key_ok = pthread_key_create(&v_alloc_scratch_key, v_alloc_scratch_exit) == 0;
+    }
+    static void v_alloc_scratch_hook(void) {
+        pthread_once(&v_alloc_scratch_once, v_alloc_scratch_key_init);
+        if (v_alloc_scratch_key_ok) {
+            pthread_setspecific(v_alloc_scratch_key, v_alloc_scratch); // the destructor only runs for non NULL values
+        }
+    }
+#endif
+
+AllocScratch v_alloc_scratch_begin(AllocInfo *conflict) {
+    AllocInfo *arena = conflict == &v_alloc_scratch[0] ? &v_alloc_scratch[1] : &v_alloc_scratch[0];
+    if (arena->base == NULL) {
+        v_alloc_scratch_hook();
+        v_alloc_reserve(arena, V_ALLOC_SCRATCH_SIZE); // on fail committ will retry the default reserve
+    }
+    AllocScratch scratch = { arena, v_alloc_mark(arena) };
+    return scratch;
+}
+// frees everything allocated in the scratch arena since the matching begin
+void v_alloc_scratch_end(AllocScratch scratch) {
+    if (scratch.arena) {
+        v_alloc_pop_to(scratch.arena, scratch.mark);
+    }
+}
+// releases the calling thread's scratch arenas. threads do this on exit, call it to give the memory back
+// earlier. the main thread's arenas are never released on their own, so with V_ALLOC_STATS the registry keeps
+// them in its listing until the process ends
+void v_alloc_scratch_release(void) {
+    for (int i = 0; i < 2; i++) {
+        v_alloc_free(&v_alloc_scratch[i]);
+        v_alloc_scratch[i] = (AllocInfo){0};
+    }
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: pool
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// reserve_size 0 reserves the default MAX_ARENA_CAPACITY. pages are committed as slots are first handed out
+bool v_pool_init(VPool *pool, size_t elem_size, size_t reserve_size) {
+    if (elem_size == 0) {
+        return false;
+    }
+    *pool = (VPool){0};
+    // free slots hold the free list link
+    pool->elem_size = ALIGN_UP(MAX(elem_size, sizeof(void *)), V_ALLOC_ALIGNMENT);
+    return v_alloc_reserve(&pool->alloc_info, reserve_size ? reserve_size : MAX_ARENA_CAPACITY);
+}
+// O(1), reuses the most recently freed slot. returns NULL when the reservation is exhausted
+void *v_pool_alloc(VPool *pool) {
+    void *ptr = pool->free_list;
+    if (ptr) {
+        pool->free_list = *(void **)ptr;
+        return ptr;
+    }
+    return v_alloc_committ(&pool->alloc_info, pool->elem_size);
+}
+void v_pool_free(VPool *pool, void *ptr) {
+    if (ptr) {
+        V_POISON_SLOT(ptr, pool->elem_size);
+        *(void **)ptr = pool->free_list;
+        pool->free_list = ptr;
+    }
+}
+// frees every slot at once, committed pages are kept according to the arena's retain policy
+void v_pool_reset(VPool *pool) {
+    pool->free_list = NULL;
+    v_alloc_reset(&pool->alloc_info);
+}
+bool v_pool_release(VPool *pool) {
+    bool result = v_alloc_free(&pool->alloc_info);
+    if (pool->owners.base) {
+        v_alloc_free(&pool->owners);
+    }
+    *pool = (VPool){0};
+    return result;
+}
+// /////////////////////////////////////////////
+// MARK: pool cache
+// /////////////////////////////////////////////
+
+// a shared pool hands out whole chunks to per thread caches. the owners table maps every chunk back to its
+// cache, so a free from another thread can be routed to the owner's remote list
+bool v_pool_init_shared(VPool *pool, size_t elem_size, size_t reserve_size) {
+    if (!v_pool_init(pool, elem_size, reserve_size)) {
+        return false;
+    }
+    size_t chunk_size = V_POOL_CACHE_CHUNK;
+    while (chunk_size < pool->elem_size) {
+        chunk_size *= 2;
+    }
+    pool->chunk_size = chunk_size;
+    size_t chunk_count = pool->alloc_info.reserved_size / chunk_size + 1;
+    if (!v_alloc_resize(&pool->owners, chunk_count * sizeof(VPoolCache *))) {
+        v_pool_release(pool);
+        return false;
+    }
+    return true;
+}
+// each thread inits its own cache and releases it with v_pool_cache_release before the thread exits
+void v_pool_cache_init(VPoolCache *cache, VPool *pool) {
+    *cache = (VPoolCache){0};
+    cache->pool = pool;
+}
+#define V_POOL_CACHE_DEAD ((void *)1) // remote_free of a released cache, closes it to late pushes
+
+static VPoolCache **v_pool_owner_slot(VPool *pool, void *ptr) {
+    return (VPoolCache **)pool->owners.base + ((char *)ptr - pool->alloc_info.base) / pool->chunk_size;
+}
+// lock free push of the linked slots first..last. consumers take the whole list at once so there's no aba.
+// false when the list was closed by a released cache
+static bool v_pool_list_push(void **list, void *first, void *last) {
+    void *head = NULL; // a failed cas loads the current head
+    do {
+        if (head == V_POOL_CACHE_DEAD) {
+            return false;
+        }
+        *(void **)last = head;
+    } while (!v_atomic_cas_ptr(list, &head, first));
+    return true;
+}
+// only touches thread local state unless the local free list and chunk are both empty
+void *v_pool_cache_alloc(VPoolCache *cache) {
+    void *ptr = cache->free_list;
+    if (ptr) {
+        cache->free_list = *(void **)ptr;
+        return ptr;
+    }
+    VPool *pool = cache->pool;
+    if (cache->chunk_end - cache->chunk_ptr >= (ptrdiff_t)pool->elem_size) {
+        ptr = cache->chunk_ptr;
+        cache->chunk_ptr += pool->elem_size;
+        return ptr;
+    }
+    // take everything other threads gave back in one exchange, then what released caches left behind
+    ptr = v_atomic_exchange_ptr(&cache->remote_free, NULL);
+    if (!ptr) {
+        ptr = v_atomic_exchange_ptr(&pool->orphan_free, NULL);
+    }
+    if (ptr) {
+        cache->free_list = *(void **)ptr;
+        return ptr;
+    }
+    char *chunk = v_alloc_committ_shared(&pool->alloc_info, pool->chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+    v_atomic_store_ptr((char **)v_pool_owner_slot(pool, chunk), (char *)cache);
+    cache->chunk_ptr = chunk + pool->elem_size;
+    cache->chunk_end = chunk + pool->chunk_size / pool->elem_size * pool->elem_size;
+    return chunk;
+}
+// cache is the calling thread's cache, not necessarily the one ptr came from
+void v_pool_cache_free(VPoolCache *cache, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    VPoolCache *owner = (VPoolCache *)v_atomic_load_ptr((char **)v_pool_owner_slot(cache->pool, ptr));
+    V_POISON_SLOT(ptr, cache->pool->elem_size);
+    if (owner == cache) {
+        *(void **)ptr = cache->free_list;
+        cache->free_list = ptr;
+        return;
+    }
+    // the chunk's owner was released (no owner, or its list is closed): the slot goes to the pool
+    if (!owner || !v_pool_list_push(&owner->remote_free, ptr, ptr)) {
+        v_pool_list_push(&cache->pool->orphan_free, ptr, ptr);
+    }
+}
+// call on the owning thread before it exits. every slot the cache holds or gets back later goes to the pool
+// for other caches to reuse. its chunks lose their owner, so frees from other threads no longer touch the
+// cache once this returns. a free racing with the release itself may still read it, keep the VPoolCache
+// storage alive (not on the exiting thread's stack) while other threads can be freeing its objects
+void v_pool_cache_release(VPoolCache *cache) {
+    VPool *pool = cache->pool;
+    if (!pool) {
+        return;
+    }
+    size_t claimed = MIN((size_t)(v_atomic_load_ptr(&pool->alloc_info.ptr) - pool->alloc_info.base),
+                         pool->alloc_info.reserved_size);
+    for (size_t i = 0; i <= claimed / pool->chunk_size; i++) {
+        VPoolCache **owner = (VPoolCache **)pool->owners.base + i;
+        if (*owner == cache) {
+            v_atomic_store_ptr((char **)owner, NULL);
+        }
+    }
+    // the rest of the current chunk joins the free list
+    while (cache->chunk_end - cache->chunk_ptr >= (ptrdiff_t)pool->elem_size) {
+        *(void **)cache->chunk_ptr = cache->free_list;
+        cache->free_list = cache->chunk_ptr;
+        cache->chunk_ptr += pool->elem_size;
+    }
+    // closing the remote list makes pushes that already read this cache as owner go to the pool instead
+    void *remote = v_atomic_exchange_ptr(&cache->remote_free, V_POOL_CACHE_DEAD);
+    void *lists[2] = { cache->free_list, remote };
+    for (int i = 0; i < 2; i++) {
+        void *last = lists[i];
+        if (!last) {
+            continue;
+        }
+        while (*(void **)last) {
+            last = *(void **)last;
+        }
+        v_pool_list_push(&pool->orphan_free, lists[i], last);
+    }
+    cache->pool = NULL;
+    cache->free_list = NULL;
+    cache->chunk_ptr = cache->chunk_end = NULL;
+}
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+// MARK: malloc
+// /////////////////////////////////////////////
+// /////////////////////////////////////////////
+
+// small sizes go to one VPool per size class, all classes carved out of one reservation so the class of a
+// pointer follows from its address. larger sizes get their own block, sized from the request
+#ifndef V_MALLOC_CLASS_RESERVE
+    #define V_MALLOC_CLASS_RESERVE ((size_t)1 << 30) // per size class, must be a power of two
+#endif
+#ifndef V_MALLOC_COMMIT_CHUNK
+    #define V_MALLOC_COMMIT_CHUNK (64 * 1024)
+#endif
+#ifndef V_MALLOC_LARGE_GROWTH
+    #define V_MALLOC_LARGE_GROWTH 2 // large blocks reserve this many times their size
+#endif
+#define V_MALLOC_SMALL_MAX (32 * 1024)
+#define V_MALLOC_CLASS_COUNT 40 // 16 byte steps up to 128, then 4 classes per power of two up to 32 KiB
+
+typedef struct VMallocClass {
+    VPool pool;
+    long lock;
+} VMallocClass;
+
+static struct {
+    AllocInfo region;
+    char *ready; // region base, published once every class is set up
+    long init_lock;
+    VMallocClass classes[V_MALLOC_CLASS_COUNT];
+} v_malloc_state;
+
+static size_t v_malloc_class_index(size_t size) {
+    if (size <= 128) {
+        return size ? (size - 1) / 16 : 0;
+    }
+    size_t bit = 63;
+    while (!(((u64)(size - 1) >> bit) & 1)) {
+        bit--;
+    }
+    return 8 + (bit - 7) * 4 + ((size - 1) >> (bit - 2)) - 4;
+}
+static size_t v_malloc_class_size(size_t index) {
+    if (index < 8) {
+        return (index + 1) * 16;
+    }
+    size_t bit = 7 + (index - 8) / 4;
+    return ((size_t)1 << bit) + ((index - 8) % 4 + 1) * ((size_t)1 << (bit - 2));
+}
+static bool v_malloc_init(void) {
+    if (v_atomic_load_ptr(&v_malloc_state.ready)) {
+        return true;
+    }
+    v_atomic_lock(&v_malloc_state.init_lock);
+    if (!v_malloc_state.ready && 
+         v_alloc_reserve(&v_malloc_state.region, V_MALLOC_CLASS_COUNT * V_MALLOC_CLASS_RESERVE)) {
+        for (size_t i = 0; i < V_MALLOC_CLASS_COUNT; i++) {
+            VPool *pool = &v_malloc_state.classes[i].pool;
+            char *base = v_malloc_state.region.base + i * V_MALLOC_CLASS_RESERVE;
+            pool->elem_size = v_malloc_class_size(i);
+            pool->alloc_info.base = pool->alloc_info.ptr = pool->alloc_info.end = base;
+            pool->alloc_info.reserved_size = V_MALLOC_CLASS_RESERVE;
+            pool->alloc_info.page_size = v_malloc_state.region.page_size;
+            v_alloc_set_commit_policy(&pool->alloc_info, V_MALLOC_COMMIT_CHUNK, 0);
+            V_STAT(v_alloc_stats_register(&pool->alloc_info));
+        }
+        V_STAT(v_alloc_stats_unregister(&v_malloc_state.region)); // reported through its classes
+        v_atomic_store_ptr(&v_malloc_state.ready, v_malloc_state.region.base);
+    }
+    v_atomic_unlock(&v_malloc_state.init_lock);
+    return v_malloc_state.ready != NULL;
+}
+// size class of a small pointer, NULL for pointers from large blocks
+static VMallocClass *v_malloc_class_of(void *ptr) {
+    char *base = v_atomic_load_ptr(&v_malloc_state.ready);
+    if (!base || (char *)ptr < base || (char *)ptr >= base + V_MALLOC_CLASS_COUNT * V_MALLOC_CLASS_RESERVE) {
+        return NULL;
+    }
+    return &v_malloc_state.classes[((char *)ptr - base) / V_MALLOC_CLASS_RESERVE];
+}
+// start of the slot holding ptr, v_malloc_aligned hands out pointers into the middle of a slot
+static char *v_malloc_slot_of(VMallocClass *size_class, void *ptr) {
+    char *base = size_class->pool.alloc_info.base;
+    size_t elem_size = size_class->pool.elem_size;
+#ifdef V_ALLOC_DEBUG // each slot ends at a page boundary followed by its guard page
+    size_t pages = ALIGN_UP(elem_size, size_class->pool.alloc_info.page_size);
+    size_t stride = pages + size_class->pool.alloc_info.page_size;
+    return base + ((char *)ptr - base) / stride * stride + pages - elem_size;
+#else
+    return base + ((char *)ptr - base) / elem_size * elem_size;
+#endif
+}
+static void *v_malloc_large_aligned(size_t size, size_t align);
+void *v_malloc(size_t size) {
+    if (size > V_MALLOC_SMALL_MAX) {
+        return v_malloc_large_aligned(size, V_ALLOC_ALIGNMENT);
+    }
+    if (!v_malloc_init()) {
+        return NULL;
+    }
+    VMallocClass *size_class = &v_malloc_state.classes[v_malloc_class_index(size)];
+    v_atomic_lock(&size_class->lock);
+    void *ptr = v_pool_alloc(&size_class->pool);
+    v_atomic_unlock(&size_class->lock);
+    return ptr;
+}
+void *v_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL; // overflow
+    }
+    size *= count;
+    void *ptr = v_malloc(size);
+    if (ptr && size <= V_MALLOC_SMALL_MAX) { // large blocks are fresh pages and already zero
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+// large blocks reserve V_MALLOC_LARGE_GROWTH times their size and commit all of it. a fully committed
+// reservation is one read/write mapping the kernel can merge with its neighbours, a partly committed one is
+// two, and vm.max_map_count would cap the number of live blocks. untouched pages cost no memory.
+// data lands on the alignment, the header right before it
+static void *v_malloc_large_aligned(size_t size, size_t align) {
+    AllocInfo alloc_info = {0};
+    size_t block_size = size + align + offsetof(AllocHdr, data);
+    if (block_size < size) {
+        return NULL; // overflow
+    }
+    size_t reserve_size = block_size > SIZE_MAX / V_MALLOC_LARGE_GROWTH ? block_size : block_size * V_MALLOC_LARGE_GROWTH;
+    if (!v_alloc_reserve(&alloc_info, reserve_size)) {
+        return NULL;
+    }
+    // strict overcommit may refuse the whole reservation, the block then commits as it grows
+    if (!v_alloc_resize(&alloc_info, alloc_info.reserved_size) && !v_alloc_resize(&alloc_info, block_size)) {
+        v_alloc_free(&alloc_info);
+        return NULL;
+    }
+    size_t offset = (char *)ALIGN_UP_PTR(alloc_info.base + offsetof(AllocHdr, data), align) - alloc_info.base;
+    AllocHdr *alloc_hdr = (AllocHdr *)(alloc_info.base + offset - offsetof(AllocHdr, data));
+    alloc_hdr->alloc_info = alloc_info;
+    V_STAT(v_alloc_stats_move(&alloc_info, &alloc_hdr->alloc_info));
+    return alloc_hdr->data;
+}
+// align must be a power of two
+void *v_malloc_aligned(size_t size, size_t align) {
+    if (align == 0 || (align & (align - 1))) {
+        return NULL;
+    }
+    if (align <= V_ALLOC_ALIGNMENT) {
+        return v_malloc(size);
+    }
+    // over aligned small requests take a class slot with room to align in, the slack must not underflow
+    if (align - V_ALLOC_ALIGNMENT < V_MALLOC_SMALL_MAX && size <= V_MALLOC_SMALL_MAX - (align - V_ALLOC_ALIGNMENT)) {
+        char *ptr = v_malloc(size + align - V_ALLOC_ALIGNMENT);
+        return ptr ? ALIGN_UP_PTR(ptr, align) : NULL;
+    }
+    return v_malloc_large_aligned(size, align);
+}
+size_t v_malloc_usable_size(void *ptr) {
+    if (!ptr) {
+        return 0;
+    }
+    VMallocClass *size_class = v_malloc_class_of(ptr);
+    if (size_class) {
+        return v_malloc_slot_of(size_class, ptr) + size_class->pool.elem_size - (char *)ptr;
+    }
+    return v_alloc_hdr_from_data(ptr)->alloc_info.end - (char *)ptr;
+}
+void v_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    VMallocClass *size_class = v_malloc_class_of(ptr);
+    if (!size_class) {
+        v_alloc_realloc(ptr, 0);
+        return;
+    }
+    char *slot = v_malloc_slot_of(size_class, ptr);
+    v_atomic_lock(&size_class->lock);
+    v_pool_free(&size_class->pool, slot);
+    v_atomic_unlock(&size_class->lock);
+}
+// small blocks move when they outgrow their class. large blocks stay in place within their reservation,
+// and move when they outgrow it or shrink below a quarter of what they have
+void *v_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return v_malloc(size);
+    }
+    if (size == 0) {
+        v_free(ptr);
+        return NULL;
+    }
+    size_t old_size = v_malloc_usable_size(ptr);
+    if (!v_malloc_class_of(ptr)) {
+        AllocInfo *alloc_info = &v_alloc_hdr_from_data(ptr)->alloc_info;
+        size_t room = alloc_info->base + alloc_info->reserved_size - (char *)ptr;
+        if (size <= old_size && size >= old_size / 4) {
+            return ptr;
+        }
+        if (size > old_size && size <= room) {
+            return v_alloc_realloc(ptr, size); // commits more of the reservation
+        }
+    } else if (size <= old_size) {
+        return ptr;
+    }
+    void *new_ptr = v_malloc(size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, MIN(old_size, size));
+        v_free(ptr);
+    }
+    return new_ptr;
+}
+// new block with its own reservation of at least reserve_size bytes
+static void *v_alloc_realloc_block(size_t total_size, size_t reserve_size) {
+    AllocInfo alloc_info = {0};
+    size_t block_size = total_size + offsetof(AllocHdr, data);
+    if (block_size < total_size || !v_alloc_reserve(&alloc_info, MAX(reserve_size, block_size))) {
+        return NULL;
+    }
+    if (!v_alloc_resize(&alloc_info, block_size)) {
+        v_alloc_free(&alloc_info);
+        return NULL;
+    }
+    AllocHdr *alloc_hdr = (AllocHdr *)alloc_info.base;
+    alloc_hdr->alloc_info = alloc_info;
+    V_STAT(v_alloc_stats_move(&alloc_info, &alloc_hdr->alloc_info));
+    return alloc_hdr->data;
+}
+// tiered v_alloc_realloc: buffers up to V_MALLOC_SMALL_MAX live in the v_malloc size classes, larger ones get
+// a reservation of reserve_hint bytes (0 for MAX_ARENA_CAPACITY) and grow in place within it. the pointer
+// moves when a buffer leaves the size classes or outgrows its reservation, which then doubles.
+// free with v_alloc_realloc_ex(data, 0, 0) or v_free
+void *v_alloc_realloc_ex(void *data, size_t total_size, size_t reserve_hint) {
+    if (total_size == 0) {
+        v_free(data);
+        return NULL;
+    }
+    if (!reserve_hint) {
+        reserve_hint = MAX_ARENA_CAPACITY;
+    }
+    if (!data || v_malloc_class_of(data)) {
+        if (total_size <= V_MALLOC_SMALL_MAX) {
+            return v_realloc(data, total_size);
+        }
+        void *new_data = v_alloc_realloc_block(total_size, reserve_hint); // promoted to its own reservation
+        if (new_data && data) {
+            memcpy(new_data, data, v_malloc_usable_size(data));
+            v_free(data);
+        }
+        return new_data;
+    }
+    AllocInfo *alloc_info = &v_alloc_hdr_from_data(data)->alloc_info;
+    size_t offset = (char *)data - alloc_info->base;
+    if (total_size <= alloc_info->reserved_size - offset) {
+        return v_alloc_realloc(data, total_size);
+    }
+    size_t reserve_size = MAX(alloc_info->reserved_size * 2, total_size + offset);
+    void *new_data = v_alloc_realloc_block(total_size, reserve_size);
+    if (new_data) {
+        memcpy(new_data, data, MIN(total_size, (size_t)(alloc_info->end - (char *)data)));
+        v_alloc_realloc(data, 0);
+    }
+    return new_data;
+}
+// LD_PRELOAD-able replacement of the libc allocator, build v_alloc.c as a shared object with V_MALLOC_OVERRIDE
+#if defined(V_MALLOC_OVERRIDE) && defined(__linux__)
+    #include <errno.h>
+    void *malloc(size_t size) { 
+        return v_malloc(size); 
+    }
+    void *calloc(size_t count, size_t size) { 
+        return v_calloc(count, size); 
+    }
+    void *realloc(void *ptr, size_t size) { 
+        return v_realloc(ptr, size); 
+    }
+    void free(void *ptr) { 
+        v_free(ptr); 
+    }
+    void *memalign(size_t align, size_t size) { 
+        return v_malloc_aligned(size, align); 
+    }
+    void *aligned_alloc(size_t align, size_t size) { 
+        return v_malloc_aligned(size, align); 
+    }
+    int posix_memalign(void **out, size_t align, size_t size) {
+        if (align % sizeof(void *) || (align & (align - 1))) {
+            return EINVAL;
+        }
+        void *ptr = v_malloc_aligned(size, align);
+        if (!ptr) {
+            return ENOMEM;
+        }
+        *out = ptr;
+        return 0;
+    }
+    void *valloc(size_t size) { 
+        return v_malloc_aligned(size, (size_t)sysconf(_SC_PAGESIZE)); 
+    }
+    void *pvalloc(size_t size) {
+        size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        return v_malloc_aligned(ALIGN_UP(size, page_size), page_size);
+    }
+    size_t malloc_usable_size(void *ptr) { 
+        return v_malloc_usable_size(ptr); 
+    }
+#endif
@@ -2,11 +2,92 @@
 #define V_ALLOC_H
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #ifndef V_ALLOC_ALIGNMENT
     #define V_ALLOC_ALIGNMENT 16
 #endif
 #define MAX_ARENA_CAPACITY (1024 * 1024 * 1024) 
+#ifndef V_ALLOC_COMMITTER_MAX
+    #define V_ALLOC_COMMITTER_MAX 64 // arenas the background committer can watch
+#endif
+#ifndef V_ALLOC_CHAIN_BLOCK
+    #define V_ALLOC_CHAIN_BLOCK (64 * 1024) // first block of a V_ALLOC_CHAINED arena reserved on first use
+#endif
+#ifndef V_ALLOC_FRAME_MAX
+    #define V_ALLOC_FRAME_MAX 3 // arenas a VFrameArena can rotate through
+#endif
+#ifndef V_ALLOC_NUMA_MAX
+    #define V_ALLOC_NUMA_MAX 8 // nodes covered by AllocNumaArenas
+#endif
+#ifndef V_ALLOC_SCRATCH_SIZE
+    #define V_ALLOC_SCRATCH_SIZE MAX_ARENA_CAPACITY // reserved per thread local scratch arena
+#endif
+
+#ifdef __cplusplus
+    #define V_ALIGNOF(T) alignof(T)
+    #define V_ALIGNAS(n) alignas(n)
+#else
+    #define V_ALIGNOF(T) _Alignof(T)
+    #define V_ALIGNAS(n) _Alignas(n)
+#endif
+
+// reserve flags, see v_alloc_reserve_ex
+#define V_ALLOC_HUGE_PAGES   (1u << 0) // 2 MiB pages: transparent huge pages on linux, large pages on windows
+#define V_ALLOC_HUGE_1G      (1u << 1) // 1 GiB hugetlb pages on linux, falls back to V_ALLOC_HUGE_PAGES
+#define V_ALLOC_PRECOMMITTED (1u << 2) // set on return when the whole reservation came back committed
+#define V_ALLOC_PREFAULT     (1u << 3) // populate newly committed pages in one call instead of faulting them in
+#define V_ALLOC_WATCHED      (1u << 4) // set while the arena is registered with the background committer
+#define V_ALLOC_FILE         (1u << 5) // backed by a file, see v_alloc_reserve_file
+#define V_ALLOC_NUMA         (1u << 6) // pages come from numa_node, see v_alloc_reserve_node
+#define V_ALLOC_CHAINED      (1u << 7) // a full reservation links in a new block instead of failing
+#define V_ALLOC_FORK_WIPE    (1u << 8) // fork children see the arena as zero pages, see v_alloc_set_fork_policy
+#define V_ALLOC_FORK_SKIP    (1u << 9) // the arena isn't mapped into fork children at all
+
+// build with V_ALLOC_DEBUG to catch overflows and use after reset: every push ends right before an
+// uncommitted guard page, pop/reset decommit everything they roll back and freed pool slots are poisoned.
+// huge page flags are ignored. compiled out by default
+#ifndef V_ALLOC_POISON
+    #define V_ALLOC_POISON 0xdd // V_ALLOC_DEBUG: byte written over freed pool slots
+#endif
+
+// build with V_ALLOC_STATS to count allocations, commits and resets per arena and to keep a registry
+// of every live arena. compiled out by default
+#ifdef V_ALLOC_STATS
+typedef struct AllocStats {
+    size_t alloc_count;
+    size_t bytes_requested;
+    size_t bytes_padding;   // lost to the V_ALLOC_ALIGNMENT round up
+    size_t commit_count;    // commit syscalls
+    size_t decommit_count;  // decommit syscalls
+    unsigned long long commit_ns;
+    unsigned long long decommit_ns;
+    size_t peak_used;       // high water mark of ptr - base
+    size_t reset_count;
+    size_t reset_used;      // ptr - base right before the last reset, a frame's peak for VFrameArena
+    // filled in by v_alloc_stats_get
+    size_t committed;
+    size_t reserved;
+} AllocStats;
+#endif
+
+// os backend of the arenas: reserve returns address space, commit makes [addr + total_size - additional_bytes,
+// addr + total_size) usable. set AllocInfo.backend to run an arena on memory of your own
+typedef struct V_Allocator {
+    // flags in/out: huge page bits that could not be honoured are cleared. page_size out: commit granularity,
+    // the reservation spans ALIGN_UP(size, page_size) bytes
+    void *(*reserve)(size_t size, unsigned *flags, size_t *page_size);
+    bool (*commit)(void *addr, size_t total_size, size_t additional_bytes);
+    bool (*decommit)(void *addr, size_t size);
+    bool (*release)(void *addr, size_t size);
+    bool (*prefault)(void *addr, size_t size); // makes committed pages resident and writable
+    size_t page_size;               // System page size
+} V_Allocator;
+extern V_Allocator v_alloc; // default backend for the current platform
 
 typedef struct AllocInfo {
     char* base;
@@ -14,14 +95,270 @@ typedef struct AllocInfo {
     char* end;
     size_t reserved_size;
     size_t page_size;
+    size_t commit_chunk; // minimum bytes per commit, 0 = page_size
+    size_t commit_max;   // nonzero: commit step doubles with the committed size up to commit_max
+    size_t retain_size;  // nonzero: pop/reset hand committed pages beyond max(ptr, retain_size) back to the os
+    size_t high_water;   // usage at reset, decays each reset. kept committed along with retain_size
+    unsigned flags;
+    long commit_lock;    // serializes commits of v_alloc_committ_shared
+    intptr_t file;         // V_ALLOC_FILE: fd on posix, file HANDLE on windows
+    intptr_t file_mapping; // V_ALLOC_FILE: file mapping HANDLE on windows
+    unsigned numa_node;    // V_ALLOC_NUMA: node the pages are bound to
+    V_Allocator *backend;  // NULL uses v_alloc
+    void *chain;           // V_ALLOC_CHAINED: header of the previous block, NULL in the first
+#ifdef V_ALLOC_STATS
+    AllocStats stats;
+    struct AllocInfo *stats_prev; // registry links, a registered AllocInfo must not be copied, nor dropped before v_alloc_free
+    struct AllocInfo *stats_next;
+#endif
 } AllocInfo;
 
+typedef struct AllocMark {
+    char *base; // identifies the arena the mark was taken from
+    char *ptr;
+} AllocMark;
+
+#ifndef V_POOL_CACHE_CHUNK
+    #define V_POOL_CACHE_CHUNK (64 * 1024) // bytes a VPoolCache claims from its shared pool at a time
+#endif
+
+// fixed size object pool, slots are carved from one reserved arena and recycled through an intrusive free list
+typedef struct VPool {
+    AllocInfo alloc_info;
+    size_t elem_size;
+    void *free_list;
+    // shared pools only (v_pool_init_shared): chunk -> owning VPoolCache
+    AllocInfo owners;
+    size_t chunk_size;
+    void *orphan_free; // slots of released caches, and frees into their chunks, for any cache to take
+} VPool;
+
+// per thread front end of a shared pool. allocs and same thread frees touch only the cache,
+// frees from other threads go onto the owner's remote_free list
+typedef struct VPoolCache {
+    VPool *pool;
+    void *free_list;
+    char *chunk_ptr;
+    char *chunk_end;
+    void *remote_free;
+} VPoolCache;
+
+// header of a v_array, lives at the start of a v_alloc_realloc block
+typedef struct VArrayHdr {
+    size_t len;
+    size_t cap;
+    V_ALIGNAS(V_ALLOC_ALIGNMENT) char data[];
+} VArrayHdr;
+
+// one arena per numa node, shared by the threads running on that node
+typedef struct AllocNumaArenas {
+    AllocInfo nodes[V_ALLOC_NUMA_MAX];
+    unsigned node_count;
+} AllocNumaArenas;
+
+// 32 bit handle into a VHandlePool: slot index in the low 24 bits, slot generation in the top 8. 0 is never valid
+typedef uint32_t VHandle;
+#define V_HANDLE_INDEX_BITS 24
+#define V_HANDLE_MAX_COUNT ((uint32_t)1 << V_HANDLE_INDEX_BITS)
+
+// fixed size slots addressed by handles. slots and generations are two contiguous arrays that only grow,
+// so a lookup is a bounds check, a generation compare and a multiply
+typedef struct VHandlePool {
+    AllocInfo slots;
+    AllocInfo generations; // one byte per slot, bumped on every free and reset
+    size_t elem_size;
+    uint32_t count;        // slots handed out at least once since the last reset
+    uint32_t free_head;    // index + 1 of the first free slot, 0 when empty
+    uint32_t capacity;     // slots committed in both arrays, never shrinks so generations survive a reset
+    uint32_t max_count;
+} VHandlePool;
+
+// ring buffer whose pages are mapped twice back to back, base[i] and base[i + size] are the same byte so
+// every span of up to size bytes is contiguous. head and tail only grow, their difference is the fill
+typedef struct VRing {
+    char *base;
+    size_t size;
+    size_t head;     // total bytes written
+    size_t tail;     // total bytes read
+    intptr_t handle; // file mapping HANDLE on windows
+} VRing;
+
+// rotates through frame_count arenas, memory allocated in a frame stays valid for frame_count - 1 more
+typedef struct VFrameArena {
+    AllocInfo frames[V_ALLOC_FRAME_MAX];
+    unsigned frame_count;
+    unsigned current;
+    size_t last_used; // bytes the frame that just ended had in use, read before advancing
+} VFrameArena;
+
+typedef struct AllocScratch {
+    AllocInfo *arena;
+    AllocMark mark;
+} AllocScratch;
+
 bool v_alloc_reserve(AllocInfo* alloc_info, size_t reserve_size);
-void *v_alloc_committ(AllocInfo* alloc_info, size_t additional_bytes);
+bool v_alloc_reserve_ex(AllocInfo* alloc_info, size_t reserve_size, unsigned flags);
+bool v_alloc_reserve_file(AllocInfo* alloc_info, const char *path, size_t reserve_size);
+bool v_alloc_reserve_node(AllocInfo* alloc_info, size_t reserve_size, unsigned node);
+void *v_alloc_push_aligned_slow(AllocInfo* alloc_info, size_t size, size_t align);
+void *v_alloc_committ_shared(AllocInfo* alloc_info, size_t additional_bytes);
 bool v_alloc_decommit(AllocInfo *alloc_info, size_t extra_size);
 void v_alloc_reset(AllocInfo* alloc_info);
+AllocMark v_alloc_mark(AllocInfo *alloc_info);
+void v_alloc_pop_to(AllocInfo *alloc_info, AllocMark mark);
 bool v_alloc_free(AllocInfo* alloc_info);
+void v_alloc_set_commit_policy(AllocInfo *alloc_info, size_t commit_chunk, size_t commit_max);
+void v_alloc_set_retain(AllocInfo *alloc_info, size_t retain_size);
+bool v_alloc_set_fork_policy(AllocInfo *alloc_info, unsigned policy);
+bool v_alloc_set_read_only(AllocInfo *alloc_info, bool read_only);
+void v_alloc_fork_child(AllocInfo *alloc_info);
+
+// ptr and end of a watched arena are read by the background committer while the owner bumps ptr, and end
+// is moved by the committer. both sides use relaxed atomics, which compile to the same plain loads and stores
+#if defined(_MSC_VER) && !defined(__clang__)
+    static inline char *v_alloc_load_relaxed(char *const *p) { return *(char *const volatile *)p; }
+    static inline void v_alloc_store_relaxed(char **p, char *v) { *(char *volatile *)p = v; }
+#else
+    static inline char *v_alloc_load_relaxed(char *const *p) { return __atomic_load_n(p, __ATOMIC_RELAXED); }
+    static inline void v_alloc_store_relaxed(char **p, char *v) { __atomic_store_n(p, v, __ATOMIC_RELAXED); }
+#endif
+
+// bump allocation of size bytes at an align boundary (a power of two), inlined so the common case is an
+// align, two compares and an add. a size of 0 wraps around in the compare and fails in the slow path, as
+// does anything that doesn't fit into the committed range. returns NULL on fail
+static inline void *v_alloc_push_aligned(AllocInfo *alloc_info, size_t size, size_t align) {
+#ifndef V_ALLOC_DEBUG // the debug layout with guard pages lives in the slow path
+    char *cur = v_alloc_load_relaxed(&alloc_info->ptr);
+    size_t avail = v_alloc_load_relaxed(&alloc_info->end) - cur;
+    size_t pad = (size_t)(0 - (uintptr_t)cur) & (align - 1);
+    if (pad < avail && size - 1 < avail - pad) {
+        char *ptr = cur + pad;
+        v_alloc_store_relaxed(&alloc_info->ptr, ptr + size);
+#ifdef V_ALLOC_STATS
+        alloc_info->stats.alloc_count++;
+        alloc_info->stats.bytes_requested += size;
+        alloc_info->stats.bytes_padding += pad;
+        if ((size_t)(alloc_info->ptr - alloc_info->base) > alloc_info->stats.peak_used) {
+            alloc_info->stats.peak_used = alloc_info->ptr - alloc_info->base;
+        }
+#endif
+        return ptr;
+    }
+#endif
+    return v_alloc_push_aligned_slow(alloc_info, size, align);
+}
+// bump allocation at V_ALLOC_ALIGNMENT. the pointer is aligned, not the size, so the next push with a
+// smaller alignment can use the tail of this one
+static inline void *v_alloc_committ(AllocInfo *alloc_info, size_t additional_bytes) {
+    return v_alloc_push_aligned(alloc_info, additional_bytes, V_ALLOC_ALIGNMENT);
+}
+// typed pushes, aligned to the natural alignment of T
+#define V_PUSH_STRUCT(arena, T) ((T *)v_alloc_push_aligned((arena), sizeof(T), V_ALIGNOF(T)))
+#define V_PUSH_ARRAY(arena, T, n) ((T *)v_alloc_push_aligned((arena), sizeof(T) * (n), V_ALIGNOF(T)))
+
+#ifndef V_ALLOC_SOA_ALIGNMENT
+    #define V_ALLOC_SOA_ALIGNMENT 64 // column alignment of v_alloc_soa, a cache line / avx-512 vector
+#endif
+bool v_alloc_committ_batch(AllocInfo *alloc_info, const size_t *sizes, void **out, size_t count);
+bool v_alloc_committ_batch_aligned(AllocInfo *alloc_info, const size_t *sizes, void **out, size_t count, size_t align);
+bool v_alloc_soa(AllocInfo *alloc_info, size_t rows, const size_t *elem_sizes, void **columns, size_t column_count);
 
 void *v_alloc_resize(AllocInfo *alloc_info, size_t size_in_bytes);
 void *v_alloc_realloc(void *data, size_t total_size);
-#endif // V_ALLOC_H
\ No newline at end of file
+void *v_alloc_realloc_ex(void *data, size_t total_size, size_t reserve_hint);
+
+#ifdef V_ALLOC_STATS
+bool v_alloc_stats_get(AllocInfo *alloc_info, AllocStats *stats);
+void v_alloc_stats_foreach(void (*fn)(AllocInfo *alloc_info, const AllocStats *stats, void *user), void *user);
+#endif
+
+bool v_alloc_committer_start(unsigned interval_us);
+void v_alloc_committer_stop(void);
+bool v_alloc_committer_add(AllocInfo *alloc_info, size_t low_water, size_t chunk);
+void v_alloc_committer_remove(AllocInfo *alloc_info);
+
+bool v_alloc_frame_init(VFrameArena *frames, unsigned frame_count, size_t reserve_size, size_t retain_size);
+AllocInfo *v_alloc_frame_advance(VFrameArena *frames);
+void v_alloc_frame_release(VFrameArena *frames);
+static inline AllocInfo *v_alloc_frame_current(VFrameArena *frames) {
+    return &frames->frames[frames->current];
+}
+
+unsigned v_alloc_numa_node_count(void);
+unsigned v_alloc_numa_current_node(void);
+bool v_alloc_numa_init(AllocNumaArenas *arenas, size_t reserve_size);
+AllocInfo *v_alloc_numa_arena(AllocNumaArenas *arenas);
+void v_alloc_numa_release(AllocNumaArenas *arenas);
+
+AllocScratch v_alloc_scratch_begin(AllocInfo *conflict);
+void v_alloc_scratch_end(AllocScratch scratch);
+void v_alloc_scratch_release(void);
+
+bool v_pool_init(VPool *pool, size_t elem_size, size_t reserve_size);
+void *v_pool_alloc(VPool *pool);
+void v_pool_free(VPool *pool, void *ptr);
+void v_pool_reset(VPool *pool);
+bool v_pool_release(VPool *pool);
+
+bool v_pool_init_shared(VPool *pool, size_t elem_size, size_t reserve_size);
+void v_pool_cache_init(VPoolCache *cache, VPool *pool);
+void *v_pool_cache_alloc(VPoolCache *cache);
+void v_pool_cache_free(VPoolCache *cache, void *ptr);
+void v_pool_cache_release(VPoolCache *cache);
+
+void *v_malloc(size_t size);
+void *v_calloc(size_t count, size_t size);
+void *v_realloc(void *ptr, size_t size);
+void *v_malloc_aligned(size_t size, size_t align);
+size_t v_malloc_usable_size(void *ptr);
+void v_free(void *ptr);
+
+bool v_handle_pool_init(VHandlePool *pool, size_t elem_size, uint32_t max_count);
+VHandle v_handle_alloc(VHandlePool *pool);
+void v_handle_free(VHandlePool *pool, VHandle handle);
+void v_handle_pool_reset(VHandlePool *pool);
+void v_handle_pool_release(VHandlePool *pool);
+// slot of a live handle, NULL for handles that were freed or reset since
+static inline void *v_handle_get(VHandlePool *pool, VHandle handle) {
+    uint32_t index = handle & (V_HANDLE_MAX_COUNT - 1);
+    if (index < pool->count && (unsigned char)pool->generations.base[index] == handle >> V_HANDLE_INDEX_BITS) {
+        return pool->slots.base + (size_t)index * pool->elem_size;
+    }
+    return NULL;
+}
+#define V_HANDLE_GET(pool, T, handle) ((T *)v_handle_get((pool), (handle)))
+
+bool v_ring_init(VRing *ring, size_t size);
+void v_ring_release(VRing *ring);
+// single producer / single consumer on one thread. write_ptr returns where the next bytes go and how many
+// fit, produce publishes n of them. read_ptr and consume do the same on the reading side
+char *v_ring_write_ptr(VRing *ring, size_t *available);
+void v_ring_produce(VRing *ring, size_t bytes);
+char *v_ring_read_ptr(VRing *ring, size_t *available);
+void v_ring_consume(VRing *ring, size_t bytes);
+
+// growable array on top of v_alloc_realloc, declare as T *a = NULL. growing only commits more pages,
+// so the array never moves and pointers into it stay valid. push/insert/reserve return false on fail
+#ifndef V_ARRAY_COMMIT_MAX
+    #define V_ARRAY_COMMIT_MAX (64 * 1024 * 1024) // commits double up to this step
+#endif
+#define v_array_hdr(a) ((VArrayHdr *)((char *)(a) - offsetof(VArrayHdr, data)))
+#define v_array_len(a) ((a) ? v_array_hdr(a)->len : 0)
+#define v_array_cap(a) ((a) ? v_array_hdr(a)->cap : 0)
+#define v_array_reserve(a, n) v_array_grow((void **)&(a), (n), sizeof(*(a)))
+#define v_array_push(a, v) \
+    (v_array_reserve((a), v_array_len(a) + 1) ? ((a)[v_array_hdr(a)->len++] = (v), true) : false)
+#define v_array_pop(a) ((a)[--v_array_hdr(a)->len]) // array must not be empty
+#define v_array_insert(a, i, v) \
+    (v_array_make_gap((void **)&(a), (i), 1, sizeof(*(a))) ? ((a)[i] = (v), true) : false)
+#define v_array_clear(a) ((a) ? (void)(v_array_hdr(a)->len = 0) : (void)0)
+#define v_array_free(a) (v_array_release(a), (a) = NULL)
+
+bool v_array_grow(void **array, size_t min_cap, size_t elem_size);
+bool v_array_make_gap(void **array, size_t index, size_t count, size_t elem_size);
+void v_array_release(void *array);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // V_ALLOC_H
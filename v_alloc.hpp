@@ -0,0 +1,79 @@
+#ifndef V_ALLOC_HPP
+#define V_ALLOC_HPP
+// header only c++17 adapters, link v_alloc.c as usual
+#include "v_alloc.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace v_mem {
+
+// pmr resource over a bump arena. deallocate is a no-op, memory comes back on reset/pop of the arena.
+// doesn't own the arena, which has to outlive every container using the resource
+class arena_resource : public std::pmr::memory_resource {
+public:
+    explicit arena_resource(AllocInfo &arena) noexcept : arena_(&arena) {}
+    arena_resource(const arena_resource &) = delete;
+    arena_resource &operator=(const arena_resource &) = delete;
+
+    AllocInfo &arena() const noexcept { return *arena_; }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void *ptr = v_alloc_push_aligned(arena_, bytes ? bytes : 1, alignment);
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    AllocInfo *arena_;
+};
+
+// monotonic buffer style scope: marks the arena on construction and rolls everything allocated through
+// it (or directly from the arena) back on destruction. containers using it must die before the scope
+class arena_scope : public arena_resource {
+public:
+    explicit arena_scope(AllocInfo &arena) noexcept : arena_resource(arena), mark_(v_alloc_mark(&arena)) {}
+    ~arena_scope() override { v_alloc_pop_to(&arena(), mark_); }
+
+private:
+    AllocMark mark_;
+};
+
+// stateless STL allocator on the v_malloc size class pools, thread safe and interchangeable between
+// instances. blocks above 32 KiB get their own reservation, sized from the request
+template <class T>
+struct pool_allocator {
+    using value_type = T;
+
+    pool_allocator() noexcept = default;
+    template <class U>
+    pool_allocator(const pool_allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n) {
+        if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void *ptr = v_malloc_aligned(n * sizeof(T), alignof(T));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+    void deallocate(T *ptr, std::size_t) noexcept { v_free(ptr); }
+};
+template <class T, class U>
+bool operator==(const pool_allocator<T> &, const pool_allocator<U> &) noexcept { return true; }
+template <class T, class U>
+bool operator!=(const pool_allocator<T> &, const pool_allocator<U> &) noexcept { return false; }
+
+} // namespace v_mem
+
+#endif // V_ALLOC_HPP